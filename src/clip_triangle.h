@@ -0,0 +1,121 @@
+#ifndef CLIP_TRIANGLE_H_
+#define CLIP_TRIANGLE_H_
+
+#include <array>
+#include <cmath>
+//
+#include "Eigen/Core"
+
+namespace acg {
+
+/**
+ * bits of the clip planes in the homogeneous coordinate q=(x,y,z,w) that the point is outside.
+ * The near plane is mapped to z=+w and the far plane to z=-w (the depth is reversed).
+ */
+enum ClipOutcode : unsigned int {
+  OutLeft = 1, // x < -w
+  OutRight = 2, // x > +w
+  OutBottom = 4, // y < -w
+  OutTop = 8, // y > +w
+  OutNear = 16, // z > +w
+  OutFar = 32, // z < -w
+};
+
+inline unsigned int clip_outcode(const Eigen::Vector4f &q) {
+  unsigned int code = 0;
+  if (q.x() < -q.w()) { code |= OutLeft; }
+  if (q.x() > +q.w()) { code |= OutRight; }
+  if (q.y() < -q.w()) { code |= OutBottom; }
+  if (q.y() > +q.w()) { code |= OutTop; }
+  if (q.z() > +q.w()) { code |= OutNear; }
+  if (q.z() < -q.w()) { code |= OutFar; }
+  return code;
+}
+
+/**
+ * Polygon made by clipping a triangle in the homogeneous coordinate. Each clip plane adds at most one corner,
+ * so the polygon has at most 3 + 6 corners after the near plane, the positive w and the four guard-band planes.
+ * @tparam ATTR attribute linearly interpolated in the homogeneous space (float or Eigen vector)
+ */
+template<typename ATTR>
+class ClippedPolygon {
+ public:
+  static constexpr unsigned int max_num_vtx = 9;
+  unsigned int num_vtx = 0;
+  std::array<Eigen::Vector4f, max_num_vtx> vtx2q;
+  std::array<ATTR, max_num_vtx> vtx2attr;
+
+  /**
+   * Sutherland–Hodgman clipping by the half space where `dist(q) >= 0`
+   * @param dist signed distance to the plane that is linear in q
+   */
+  template<typename DIST>
+  void clip(DIST &&dist) {
+    ClippedPolygon<ATTR> out;
+    for (unsigned int i0 = 0; i0 < num_vtx; ++i0) {
+      const unsigned int i1 = (i0 + 1) % num_vtx;
+      const float d0 = dist(vtx2q[i0]), d1 = dist(vtx2q[i1]);
+      if (d0 >= 0.f) { out.add(vtx2q[i0], vtx2attr[i0]); }
+      if ((d0 >= 0.f) != (d1 >= 0.f)) { // the edge crosses the plane
+        const float t = d0 / (d0 - d1);
+        out.add(vtx2q[i0] + (vtx2q[i1] - vtx2q[i0]) * t, vtx2attr[i0] + (vtx2attr[i1] - vtx2attr[i0]) * t);
+      }
+    }
+    *this = out;
+  }
+
+  void add(const Eigen::Vector4f &q, const ATTR &attr) {
+    if (num_vtx == max_num_vtx) { return; }
+    vtx2q[num_vtx] = q;
+    vtx2attr[num_vtx] = attr;
+    num_vtx += 1;
+  }
+};
+
+/**
+ * Result of the classification of a triangle against the view frustum
+ */
+enum class ClipResult {
+  Outside, // the whole triangle is outside one of the planes of the frustum
+  Inside, // the triangle can be rasterized without clipping
+  Clipped, // the triangle crosses the near plane or the guard band and was clipped
+};
+
+/**
+ * cull the triangle outside the view frustum and clip the triangle crossing the near plane in the homogeneous space.
+ * The left/right/bottom/top planes are not clipped, as the rasterizer only visits the pixels of the image, but
+ * the triangle is clipped by the guard band |x|,|y| <= guard_band * w if it goes beyond it,
+ * so the screen coordinates after the division by w stay small enough for the float precision.
+ * @param guard_band size of the guard band relative to the image (in the normalized device coordinate)
+ * @param polygon clipped polygon (convex), which is set only if the result is `Clipped`
+ */
+template<typename ATTR>
+ClipResult clip_triangle(
+    const std::array<Eigen::Vector4f, 3> &q,
+    const std::array<ATTR, 3> &attr,
+    ClippedPolygon<ATTR> &polygon,
+    float guard_band = 16.f) {
+  const unsigned int code0 = clip_outcode(q[0]), code1 = clip_outcode(q[1]), code2 = clip_outcode(q[2]);
+  if ((code0 & code1 & code2) != 0) { return ClipResult::Outside; } // all corners outside the same plane
+  const auto is_in_guard_band = [&](const Eigen::Vector4f &p) {
+    return std::abs(p.x()) <= guard_band * p.w() && std::abs(p.y()) <= guard_band * p.w();
+  };
+  if (((code0 | code1 | code2) & OutNear) == 0
+      && is_in_guard_band(q[0]) && is_in_guard_band(q[1]) && is_in_guard_band(q[2])) {
+    return ClipResult::Inside;
+  }
+  polygon.num_vtx = 0;
+  for (unsigned int i = 0; i < 3; ++i) { polygon.add(q[i], attr[i]); }
+  constexpr float w_min = 1.0e-5f;
+  polygon.clip([](const Eigen::Vector4f &p) { return p.w() - p.z(); }); // near plane
+  polygon.clip([](const Eigen::Vector4f &p) { return p.w() - w_min; }); // in front of the camera
+  polygon.clip([&](const Eigen::Vector4f &p) { return guard_band * p.w() - p.x(); });
+  polygon.clip([&](const Eigen::Vector4f &p) { return guard_band * p.w() + p.x(); });
+  polygon.clip([&](const Eigen::Vector4f &p) { return guard_band * p.w() - p.y(); });
+  polygon.clip([&](const Eigen::Vector4f &p) { return guard_band * p.w() + p.y(); });
+  return polygon.num_vtx >= 3 ? ClipResult::Clipped : ClipResult::Outside;
+}
+
+} // namespace acg
+
+#endif //CLIP_TRIANGLE_H_
@@ -0,0 +1,151 @@
+#ifndef CURVE_GRID_H_
+#define CURVE_GRID_H_
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+//
+#include "Eigen/Core"
+#include "parse_svg.h"
+#include "util_bezier.h"
+
+namespace acg {
+
+/**
+ * Uniform grid over the pieces of the outline for the inside/outside query.
+ * The curves are split at their extrema so every piece is monotone in both x and y,
+ * and each piece is registered to the cells overlapping its bounding box.
+ * The parity of the crossing number is precomputed at the center of each cell, so a query only counts
+ * the crossings of the short path from the cell center to the point against the pieces in that cell.
+ */
+class CurveGrid {
+ public:
+  std::vector<Edge> pieces; // pieces monotone in x and y
+  Eigen::Vector2f pmin; // corner of the grid
+  float cell_size = 1.f;
+  unsigned int num_cell_x = 0;
+  unsigned int num_cell_y = 0;
+  std::vector<unsigned int> cell2idx; // pieces of the i-th cell are idx2piece[cell2idx[i]:cell2idx[i+1]]
+  std::vector<unsigned int> idx2piece;
+  std::vector<unsigned char> cell2parity; // parity of the crossing number at the cell center
+ public:
+  /**
+   * build the grid
+   * @param edges line segments and quadratic Bézier curves of closed loops
+   * @param num_cell_per_piece number of cells relative to the number of the pieces
+   */
+  explicit CurveGrid(
+      const std::vector<Edge> &edges,
+      float num_cell_per_piece = 2.f) {
+    pieces = monotone_pieces(edges, true);
+    if (pieces.empty()) { return; }
+    // the control point of a monotone piece is inside the box of its end points
+    pmin = pieces[0].ps;
+    Eigen::Vector2f pmax = pieces[0].ps;
+    for (const auto &piece: pieces) {
+      pmin = pmin.cwiseMin(piece.ps).cwiseMin(piece.pe);
+      pmax = pmax.cwiseMax(piece.ps).cwiseMax(piece.pe);
+    }
+    const Eigen::Vector2f size = pmax - pmin;
+    const float num_cell = std::max(1.f, num_cell_per_piece * float(pieces.size()));
+    cell_size = std::max(std::sqrt(size.x() * size.y() / num_cell), 1.0e-3f * std::max(size.x(), size.y()));
+    cell_size = std::max(cell_size, 1.0e-10f);
+    num_cell_x = static_cast<unsigned int>(std::floor(size.x() / cell_size)) + 1;
+    num_cell_y = static_cast<unsigned int>(std::floor(size.y() / cell_size)) + 1;
+    // register the pieces to the cells in two passes (count, then fill)
+    cell2idx.assign(num_cell_x * num_cell_y + 1, 0);
+    for (unsigned int pass = 0; pass < 2; ++pass) {
+      for (unsigned int i_piece = 0; i_piece < pieces.size(); ++i_piece) {
+        const auto[ix0, iy0] = cell_index(pieces[i_piece].ps.cwiseMin(pieces[i_piece].pe));
+        const auto[ix1, iy1] = cell_index(pieces[i_piece].ps.cwiseMax(pieces[i_piece].pe));
+        for (unsigned int iy = iy0; iy <= iy1; ++iy) {
+          for (unsigned int ix = ix0; ix <= ix1; ++ix) {
+            const unsigned int i_cell = iy * num_cell_x + ix;
+            if (pass == 0) {
+              cell2idx[i_cell + 1] += 1;
+            } else {
+              idx2piece[cell2idx[i_cell]++] = i_piece;
+            }
+          }
+        }
+      }
+      if (pass == 0) {
+        for (unsigned int i_cell = 0; i_cell < num_cell_x * num_cell_y; ++i_cell) {
+          cell2idx[i_cell + 1] += cell2idx[i_cell];
+        }
+        idx2piece.resize(cell2idx.back());
+      } else { // the fill pass advanced each start index to the next cell's start
+        for (unsigned int i_cell = num_cell_x * num_cell_y; i_cell > 0; --i_cell) {
+          cell2idx[i_cell] = cell2idx[i_cell - 1];
+        }
+        cell2idx[0] = 0;
+      }
+    }
+    // parity at the cell centers from the crossings on the horizontal line through each row of the centers
+    cell2parity.assign(num_cell_x * num_cell_y, 0);
+    std::vector<float> crossings;
+    for (unsigned int iy = 0; iy < num_cell_y; ++iy) {
+      const float y = center_of_cell(0, iy).y();
+      crossings.clear();
+      for (const auto &piece: pieces) {
+        if ((piece.ps.y() <= y) == (piece.pe.y() <= y)) { continue; }
+        crossings.push_back(x_crossing_horizontal_line(piece, y));
+      }
+      std::sort(crossings.begin(), crossings.end());
+      for (unsigned int ix = 0; ix < num_cell_x; ++ix) {
+        const float x = center_of_cell(ix, iy).x();
+        const auto num_right = crossings.end() - std::upper_bound(crossings.begin(), crossings.end(), x);
+        cell2parity[iy * num_cell_x + ix] = static_cast<unsigned char>(num_right % 2);
+      }
+    }
+  }
+
+  /**
+   * index of the cell containing the point (clamped to the grid)
+   */
+  [[nodiscard]] std::pair<unsigned int, unsigned int> cell_index(const Eigen::Vector2f &p) const {
+    const float x = std::floor((p.x() - pmin.x()) / cell_size);
+    const float y = std::floor((p.y() - pmin.y()) / cell_size);
+    return {
+        static_cast<unsigned int>(std::clamp(x, 0.f, float(num_cell_x - 1))),
+        static_cast<unsigned int>(std::clamp(y, 0.f, float(num_cell_y - 1)))};
+  }
+
+  [[nodiscard]] Eigen::Vector2f center_of_cell(unsigned int ix, unsigned int iy) const {
+    return pmin + Eigen::Vector2f(float(ix) + 0.5f, float(iy) + 0.5f) * cell_size;
+  }
+
+  /**
+   * inside/outside test by the even-odd rule
+   * @param p query point
+   * @return true if the point is inside
+   */
+  [[nodiscard]] bool is_inside(const Eigen::Vector2f &p) const {
+    if (pieces.empty()) { return false; }
+    const Eigen::Vector2f pmax = pmin + Eigen::Vector2f(float(num_cell_x), float(num_cell_y)) * cell_size;
+    if (p.x() < pmin.x() || p.y() < pmin.y() || p.x() >= pmax.x() || p.y() >= pmax.y()) { return false; }
+    const auto[ix, iy] = cell_index(p);
+    const Eigen::Vector2f c = center_of_cell(ix, iy);
+    // walk from the center to the point along an L-shaped path: (cx,cy) -> (px,cy) -> (px,py)
+    const float x0 = std::min(c.x(), p.x()), x1 = std::max(c.x(), p.x());
+    const float y0 = std::min(c.y(), p.y()), y1 = std::max(c.y(), p.y());
+    unsigned int parity = cell2parity[iy * num_cell_x + ix];
+    const unsigned int i_cell = iy * num_cell_x + ix;
+    for (unsigned int idx = cell2idx[i_cell]; idx < cell2idx[i_cell + 1]; ++idx) {
+      const Edge &piece = pieces[idx2piece[idx]];
+      if ((piece.ps.y() <= c.y()) != (piece.pe.y() <= c.y())) { // horizontal part, crossings in (x0, x1]
+        const float x = x_crossing_horizontal_line(piece, c.y());
+        if (x > x0 && x <= x1) { parity ^= 1; }
+      }
+      if ((piece.ps.x() <= p.x()) != (piece.pe.x() <= p.x())) { // vertical part, crossings in (y0, y1]
+        const float y = y_crossing_vertical_line(piece, p.x());
+        if (y > y0 && y <= y1) { parity ^= 1; }
+      }
+    }
+    return parity == 1;
+  }
+};
+
+} // namespace acg
+
+#endif //CURVE_GRID_H_
@@ -0,0 +1,143 @@
+#ifndef DENOISE_H_
+#define DENOISE_H_
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+//
+#include "util_parallel.h"
+
+namespace acg {
+
+/**
+ * Feature buffers rendered next to the radiance image. They guide the edge-aware denoiser.
+ */
+class AuxiliaryBuffers {
+ public:
+  unsigned int width;
+  unsigned int height;
+  std::vector<float> pix2nrm; // normal at the first hit (3 floats per pixel)
+  std::vector<float> pix2depth; // distance from the camera to the first hit
+  std::vector<float> pix2albedo; // reflectance of the first hit
+  std::vector<int> pix2id; // index of the object at the first hit (-1 if nothing is hit)
+ public:
+  AuxiliaryBuffers(unsigned int width_, unsigned int height_)
+      : width(width_), height(height_),
+        pix2nrm(width_ * height_ * 3, 0.f),
+        pix2depth(width_ * height_, 0.f),
+        pix2albedo(width_ * height_, 0.f),
+        pix2id(width_ * height_, -1) {}
+  /**
+   * set the features of the first hit at a pixel
+   */
+  void set(
+      unsigned int i_pix,
+      float nx, float ny, float nz,
+      float depth,
+      float albedo,
+      int id) {
+    pix2nrm[i_pix * 3 + 0] = nx;
+    pix2nrm[i_pix * 3 + 1] = ny;
+    pix2nrm[i_pix * 3 + 2] = nz;
+    pix2depth[i_pix] = depth;
+    pix2albedo[i_pix] = albedo;
+    pix2id[i_pix] = id;
+  }
+};
+
+/**
+ * Parameters of the edge-aware a-trous wavelet denoiser
+ */
+class AtrousParameter {
+ public:
+  unsigned int num_iteration = 5; // the filter footprint becomes 4 * 2^num_iteration pixels
+  float sigma_color = 0.5f; // tolerance to the difference of the color (halved at each iteration)
+  float exponent_normal = 64.f; // larger value preserves the edges of the normal more strictly
+  float sigma_depth = 0.05f; // tolerance to the difference of the depth (relative to the depth)
+};
+
+/**
+ * Edge-aware a-trous wavelet filter (Dammertz et al. 2010) guided by the auxiliary buffers.
+ * The radiance is divided by the albedo before filtering and multiplied back afterwards,
+ * so the texture of the albedo is not blurred. Pixels of different objects are never mixed.
+ * @param[in,out] img radiance image (`num_channel` floats per pixel)
+ * @param num_channel number of channels of the image
+ * @param aux auxiliary buffers of the same size as the image
+ * @param param parameters of the filter
+ * @param num_thread number of threads (0: use all the hardware threads)
+ */
+void denoise_atrous(
+    std::vector<float> &img,
+    unsigned int num_channel,
+    const AuxiliaryBuffers &aux,
+    const AtrousParameter &param = AtrousParameter(),
+    unsigned int num_thread = 0) {
+  const unsigned int width = aux.width;
+  const unsigned int height = aux.height;
+  constexpr float kernel[5] = {1.f / 16.f, 1.f / 4.f, 3.f / 8.f, 1.f / 4.f, 1.f / 16.f}; // B3 spline
+  std::vector<float> img_in(img.size());
+  for (unsigned int i_pix = 0; i_pix < width * height; ++i_pix) { // demodulate albedo
+    const float albedo = aux.pix2albedo[i_pix];
+    for (unsigned int i_ch = 0; i_ch < num_channel; ++i_ch) {
+      const float c = img[i_pix * num_channel + i_ch];
+      img_in[i_pix * num_channel + i_ch] = albedo > 0.f ? c / albedo : c;
+    }
+  }
+  std::vector<float> img_out(img.size());
+  for (unsigned int i_iter = 0; i_iter < param.num_iteration; ++i_iter) {
+    const int step = 1 << i_iter;
+    const float sigma_color = param.sigma_color / float(1 << i_iter);
+    parallel_for(height, [&](unsigned int ih) {
+      for (unsigned int iw = 0; iw < width; ++iw) {
+        const unsigned int ip = ih * width + iw;
+        const float *cp = img_in.data() + ip * num_channel;
+        float *out = img_out.data() + ip * num_channel;
+        if (aux.pix2id[ip] == -1) { // background is not filtered
+          for (unsigned int i_ch = 0; i_ch < num_channel; ++i_ch) { out[i_ch] = cp[i_ch]; }
+          continue;
+        }
+        const float *np = aux.pix2nrm.data() + ip * 3;
+        const float depth_p = aux.pix2depth[ip];
+        float sum_weight = 0.f;
+        for (unsigned int i_ch = 0; i_ch < num_channel; ++i_ch) { out[i_ch] = 0.f; }
+        for (int jh = -2; jh <= 2; ++jh) {
+          const int qh = int(ih) + jh * step;
+          if (qh < 0 || qh >= int(height)) { continue; }
+          for (int jw = -2; jw <= 2; ++jw) {
+            const int qw = int(iw) + jw * step;
+            if (qw < 0 || qw >= int(width)) { continue; }
+            const unsigned int iq = qh * width + qw;
+            if (aux.pix2id[iq] != aux.pix2id[ip]) { continue; }
+            const float *cq = img_in.data() + iq * num_channel;
+            const float *nq = aux.pix2nrm.data() + iq * 3;
+            float sqdist_color = 0.f;
+            for (unsigned int i_ch = 0; i_ch < num_channel; ++i_ch) {
+              sqdist_color += (cp[i_ch] - cq[i_ch]) * (cp[i_ch] - cq[i_ch]);
+            }
+            const float w_color = std::exp(-sqdist_color / (sigma_color * sigma_color));
+            const float cos_nrm = std::max(0.f, np[0] * nq[0] + np[1] * nq[1] + np[2] * nq[2]);
+            const float w_nrm = std::pow(cos_nrm, param.exponent_normal);
+            const float w_depth = std::exp(
+                -std::fabs(depth_p - aux.pix2depth[iq]) / (param.sigma_depth * depth_p * float(step) + 1.0e-10f));
+            const float w = kernel[jh + 2] * kernel[jw + 2] * w_color * w_nrm * w_depth;
+            for (unsigned int i_ch = 0; i_ch < num_channel; ++i_ch) { out[i_ch] += w * cq[i_ch]; }
+            sum_weight += w;
+          }
+        }
+        for (unsigned int i_ch = 0; i_ch < num_channel; ++i_ch) { out[i_ch] /= sum_weight; }
+      }
+    }, num_thread);
+    std::swap(img_in, img_out);
+  }
+  for (unsigned int i_pix = 0; i_pix < width * height; ++i_pix) { // modulate albedo
+    const float albedo = aux.pix2albedo[i_pix];
+    for (unsigned int i_ch = 0; i_ch < num_channel; ++i_ch) {
+      const float c = img_in[i_pix * num_channel + i_ch];
+      img[i_pix * num_channel + i_ch] = albedo > 0.f ? c * albedo : c;
+    }
+  }
+}
+
+} // namespace acg
+
+#endif //DENOISE_H_
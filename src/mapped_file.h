@@ -0,0 +1,92 @@
+#ifndef MAPPED_FILE_H_
+#define MAPPED_FILE_H_
+
+#include <string>
+#include <string_view>
+#include <filesystem>
+//
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace acg {
+
+/**
+ * Read-only memory mapping of a whole file. The contents are paged in by the OS on access without being copied.
+ * The mapping is released when the object is destroyed.
+ */
+class MappedFile {
+ public:
+  explicit MappedFile(const std::filesystem::path &file_path) {
+#if defined(_WIN32)
+    file = CreateFileW(file_path.wstring().c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                       OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) { return; }
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0) { return; }
+    mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping) { return; }
+    void *ptr = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!ptr) { return; }
+    data_ = static_cast<const char *>(ptr);
+    size_ = static_cast<size_t>(file_size.QuadPart);
+#else
+    fd = open(file_path.c_str(), O_RDONLY);
+    if (fd == -1) { return; }
+    struct stat st{};
+    if (fstat(fd, &st) != 0 || st.st_size == 0) { return; }
+    void *ptr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (ptr == MAP_FAILED) { return; }
+    madvise(ptr, st.st_size, MADV_SEQUENTIAL);
+    data_ = static_cast<const char *>(ptr);
+    size_ = static_cast<size_t>(st.st_size);
+#endif
+  }
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  ~MappedFile() {
+#if defined(_WIN32)
+    if (data_) { UnmapViewOfFile(data_); }
+    if (mapping) { CloseHandle(mapping); }
+    if (file != INVALID_HANDLE_VALUE) { CloseHandle(file); }
+#else
+    if (data_) { munmap(const_cast<char *>(data_), size_); }
+    if (fd != -1) { close(fd); }
+#endif
+  }
+
+  /**
+   * @return true if the file is mapped (an empty file is not mapped)
+   */
+  [[nodiscard]] bool is_open() const { return data_ != nullptr; }
+
+  [[nodiscard]] const char *data() const { return data_; }
+
+  [[nodiscard]] size_t size() const { return size_; }
+
+  [[nodiscard]] std::string_view view() const { return {data_, size_}; }
+
+ private:
+  const char *data_ = nullptr;
+  size_t size_ = 0;
+#if defined(_WIN32)
+  HANDLE file = INVALID_HANDLE_VALUE;
+  HANDLE mapping = nullptr;
+#else
+  int fd = -1;
+#endif
+};
+
+} // namespace acg
+
+#endif //MAPPED_FILE_H_
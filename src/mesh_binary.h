@@ -0,0 +1,228 @@
+#ifndef MESH_BINARY_H_
+#define MESH_BINARY_H_
+
+#include <vector>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <numeric>
+#include <algorithm>
+#include <filesystem>
+#include <type_traits>
+//
+#include "Eigen/Dense"
+#include "mapped_file.h"
+#include "util_triangle_mesh.h"
+
+namespace acg {
+
+/**
+ * Header at the beginning of the binary mesh file (".acgm").
+ * The blocks of the arrays follow the header at the offsets aligned to 64 bytes:
+ * vtx2xyz (3 floats per vertex), tri2vtx (3 uint32 per triangle), and optionally vtx2nrm (3 floats per vertex)
+ * and vtx2uv (2 floats per vertex). The numbers are stored in the little endian.
+ */
+class MeshBinaryHeader {
+ public:
+  static constexpr std::uint32_t has_normal = 1;
+  static constexpr std::uint32_t has_uv = 2;
+  static constexpr std::uint32_t current_version = 1;
+  char magic[4] = {'A', 'C', 'G', 'M'};
+  std::uint32_t version = current_version;
+  std::uint32_t num_vtx = 0;
+  std::uint32_t num_tri = 0;
+  std::uint32_t flags = 0; // combination of `has_normal` and `has_uv`
+  float aabb_min[3] = {0.f, 0.f, 0.f}; // bounding box of the vertices
+  float aabb_max[3] = {0.f, 0.f, 0.f};
+  std::uint32_t reserved = 0; // explicit padding to align the offsets, so no uninitialized byte is written
+  std::uint64_t offset_xyz = 0; // offsets of the blocks from the beginning of the file in bytes (0 if absent)
+  std::uint64_t offset_tri = 0;
+  std::uint64_t offset_nrm = 0;
+  std::uint64_t offset_uv = 0;
+};
+static_assert(std::is_trivially_copyable_v<MeshBinaryHeader> && sizeof(MeshBinaryHeader) == 80);
+
+/**
+ * write the binary mesh file
+ * @param tri2vtx vertex indices of the triangles (3 per triangle)
+ * @param vtx2xyz coordinates of the vertices (3 per vertex)
+ * @param vtx2nrm normals of the vertices (3 per vertex, or empty)
+ * @param vtx2uv texture coordinates of the vertices (2 per vertex, or empty)
+ * @return false if the file cannot be written
+ */
+inline bool write_mesh_binary(
+    const std::filesystem::path &file_path,
+    const std::vector<unsigned int> &tri2vtx,
+    const std::vector<float> &vtx2xyz,
+    const std::vector<float> &vtx2nrm,
+    const std::vector<float> &vtx2uv) {
+  constexpr std::uint64_t alignment = 64;
+  const auto align = [](std::uint64_t pos) { return (pos + alignment - 1) / alignment * alignment; };
+  MeshBinaryHeader header;
+  header.num_vtx = static_cast<std::uint32_t>(vtx2xyz.size() / 3);
+  header.num_tri = static_cast<std::uint32_t>(tri2vtx.size() / 3);
+  if (header.num_vtx > 0) {
+    const Eigen::Map<const Eigen::Matrix3Xf> xyz(vtx2xyz.data(), 3, header.num_vtx);
+    Eigen::Map<Eigen::Vector3f>(header.aabb_min) = xyz.rowwise().minCoeff();
+    Eigen::Map<Eigen::Vector3f>(header.aabb_max) = xyz.rowwise().maxCoeff();
+  }
+  std::uint64_t pos = align(sizeof(MeshBinaryHeader));
+  const auto allocate = [&](std::uint64_t num_byte) {
+    const std::uint64_t offset = pos;
+    pos = align(pos + num_byte);
+    return offset;
+  };
+  header.offset_xyz = allocate(vtx2xyz.size() * sizeof(float));
+  header.offset_tri = allocate(tri2vtx.size() * sizeof(std::uint32_t));
+  if (!vtx2nrm.empty() && vtx2nrm.size() == vtx2xyz.size()) {
+    header.flags |= MeshBinaryHeader::has_normal;
+    header.offset_nrm = allocate(vtx2nrm.size() * sizeof(float));
+  }
+  if (!vtx2uv.empty() && vtx2uv.size() / 2 == header.num_vtx) {
+    header.flags |= MeshBinaryHeader::has_uv;
+    header.offset_uv = allocate(vtx2uv.size() * sizeof(float));
+  }
+  std::ofstream fout(file_path, std::ios::binary);
+  if (!fout) { return false; }
+  const auto write_block = [&](std::uint64_t offset, const void *data, size_t num_byte) {
+    const auto cur = static_cast<std::uint64_t>(fout.tellp());
+    const std::vector<char> zeros(offset - cur, 0); // padding for the alignment
+    fout.write(zeros.data(), static_cast<std::streamsize>(zeros.size()));
+    fout.write(static_cast<const char *>(data), static_cast<std::streamsize>(num_byte));
+  };
+  write_block(0, &header, sizeof(header));
+  write_block(header.offset_xyz, vtx2xyz.data(), vtx2xyz.size() * sizeof(float));
+  write_block(header.offset_tri, tri2vtx.data(), tri2vtx.size() * sizeof(std::uint32_t));
+  if (header.flags & MeshBinaryHeader::has_normal) {
+    write_block(header.offset_nrm, vtx2nrm.data(), vtx2nrm.size() * sizeof(float));
+  }
+  if (header.flags & MeshBinaryHeader::has_uv) {
+    write_block(header.offset_uv, vtx2uv.data(), vtx2uv.size() * sizeof(float));
+  }
+  return static_cast<bool>(fout);
+}
+
+/**
+ * convert the Wavefront OBJ to the binary mesh file. The corners of the OBJ referring to the same position but
+ * different texture coordinates or normals are split into different vertices, since the binary mesh has one index
+ * per corner. The normals are computed from the triangles if the OBJ has none and `compute_normal` is true.
+ * @return false if the file cannot be written
+ */
+inline bool write_mesh_binary(
+    const std::filesystem::path &file_path,
+    const WavefrontObj &obj,
+    bool compute_normal = true) {
+  const auto num_corner = static_cast<unsigned int>(obj.tri2vtx.size());
+  const bool is_uv = !obj.tri2uv.empty() && std::all_of(
+      obj.tri2uv.begin(), obj.tri2uv.end(), [](unsigned int i) { return i != UINT_MAX; });
+  const bool is_nrm = !obj.tri2nrm.empty() && std::all_of(
+      obj.tri2nrm.begin(), obj.tri2nrm.end(), [](unsigned int i) { return i != UINT_MAX; });
+  std::vector<unsigned int> tri2vtx;
+  std::vector<float> vtx2xyz, vtx2nrm, vtx2uv;
+  if (!is_uv && !is_nrm) { // the positions are the vertices
+    tri2vtx = obj.tri2vtx;
+    vtx2xyz = obj.vtx2xyz;
+  } else { // unique combinations of the indices {v, vt, vn} become the vertices
+    const auto key = [&](unsigned int i) -> std::array<unsigned int, 3> {
+      return {obj.tri2vtx[i], is_uv ? obj.tri2uv[i] : 0, is_nrm ? obj.tri2nrm[i] : 0};
+    };
+    std::vector<unsigned int> order(num_corner);
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&](unsigned int a, unsigned int b) { return key(a) < key(b); });
+    tri2vtx.resize(num_corner);
+    for (unsigned int idx = 0; idx < num_corner; ++idx) {
+      const unsigned int i_corner = order[idx];
+      if (idx == 0 || key(order[idx - 1]) != key(i_corner)) { // new vertex
+        const auto[iv, it, in] = key(i_corner);
+        vtx2xyz.insert(vtx2xyz.end(), obj.vtx2xyz.begin() + iv * 3, obj.vtx2xyz.begin() + iv * 3 + 3);
+        if (is_uv) { vtx2uv.insert(vtx2uv.end(), obj.vtx2uv.begin() + it * 2, obj.vtx2uv.begin() + it * 2 + 2); }
+        if (is_nrm) { vtx2nrm.insert(vtx2nrm.end(), obj.vtx2nrm.begin() + in * 3, obj.vtx2nrm.begin() + in * 3 + 3); }
+      }
+      tri2vtx[i_corner] = static_cast<unsigned int>(vtx2xyz.size() / 3 - 1);
+    }
+  }
+  if (!is_nrm && compute_normal && !tri2vtx.empty()) {
+    const Eigen::Matrix3Xf vtx2normal = vertex_normals_of_triangle_mesh(
+        Eigen::Map<const Eigen::Matrix<unsigned int, 3, Eigen::Dynamic>>(tri2vtx.data(), 3, tri2vtx.size() / 3),
+        Eigen::Map<const Eigen::Matrix3Xf>(vtx2xyz.data(), 3, vtx2xyz.size() / 3));
+    vtx2nrm.assign(vtx2normal.data(), vtx2normal.data() + vtx2normal.size());
+  }
+  return write_mesh_binary(file_path, tri2vtx, vtx2xyz, vtx2nrm, vtx2uv);
+}
+
+/**
+ * Binary mesh file mapped to the memory. The arrays are accessed through `Eigen::Map` views of the mapping
+ * without being copied or parsed, so opening a mesh costs almost nothing until its pages are touched.
+ * The views are valid while this object is alive. The file is rejected if a block is out of the file or a vertex
+ * index is out of the vertices, which costs one pass over the indices.
+ */
+class MeshBinary {
+ public:
+  using Matrix3Xui = Eigen::Matrix<unsigned int, 3, Eigen::Dynamic>;
+
+  explicit MeshBinary(const std::filesystem::path &file_path) : file(file_path) {
+    if (!file.is_open() || file.size() < sizeof(MeshBinaryHeader)) { return; }
+    std::memcpy(&header, file.data(), sizeof(MeshBinaryHeader));
+    if (std::memcmp(header.magic, "ACGM", 4) != 0 || header.version != MeshBinaryHeader::current_version) { return; }
+    const auto is_in_file = [&](std::uint64_t offset, std::uint64_t num_byte) {
+      return offset % alignof(float) == 0 && offset <= file.size() && num_byte <= file.size() - offset;
+    };
+    is_valid = is_in_file(header.offset_xyz, std::uint64_t(header.num_vtx) * 3 * sizeof(float))
+        && is_in_file(header.offset_tri, std::uint64_t(header.num_tri) * 3 * sizeof(std::uint32_t))
+        && (!has_normal() || is_in_file(header.offset_nrm, std::uint64_t(header.num_vtx) * 3 * sizeof(float)))
+        && (!has_uv() || is_in_file(header.offset_uv, std::uint64_t(header.num_vtx) * 2 * sizeof(float)));
+    if (is_valid && header.num_tri > 0) { is_valid = tri2vtx().maxCoeff() < header.num_vtx; }
+  }
+
+  /**
+   * @return true if the file is mapped, its header is consistent with its size, and the vertex indices are valid
+   */
+  [[nodiscard]] bool is_open() const { return is_valid; }
+
+  [[nodiscard]] unsigned int num_vtx() const { return header.num_vtx; }
+
+  [[nodiscard]] unsigned int num_tri() const { return header.num_tri; }
+
+  [[nodiscard]] bool has_normal() const { return header.flags & MeshBinaryHeader::has_normal; }
+
+  [[nodiscard]] bool has_uv() const { return header.flags & MeshBinaryHeader::has_uv; }
+
+  [[nodiscard]] Eigen::Vector3f aabb_min() const { return Eigen::Vector3f(header.aabb_min); }
+
+  [[nodiscard]] Eigen::Vector3f aabb_max() const { return Eigen::Vector3f(header.aabb_max); }
+
+  [[nodiscard]] Eigen::Map<const Eigen::Matrix3Xf> vtx2xyz() const {
+    return {block<float>(header.offset_xyz), 3, header.num_vtx};
+  }
+
+  [[nodiscard]] Eigen::Map<const Matrix3Xui> tri2vtx() const {
+    return {block<unsigned int>(header.offset_tri), 3, header.num_tri};
+  }
+
+  /**
+   * @return normals of the vertices (3x0 if the file has no normal)
+   */
+  [[nodiscard]] Eigen::Map<const Eigen::Matrix3Xf> vtx2nrm() const {
+    return {block<float>(header.offset_nrm), 3, has_normal() ? header.num_vtx : 0};
+  }
+
+  /**
+   * @return texture coordinates of the vertices (2x0 if the file has no texture coordinate)
+   */
+  [[nodiscard]] Eigen::Map<const Eigen::Matrix2Xf> vtx2uv() const {
+    return {block<float>(header.offset_uv), 2, has_uv() ? header.num_vtx : 0};
+  }
+
+ private:
+  template<typename T>
+  const T *block(std::uint64_t offset) const { return reinterpret_cast<const T *>(file.data() + offset); }
+
+  MappedFile file;
+  MeshBinaryHeader header;
+  bool is_valid = false;
+};
+
+} // namespace acg
+
+#endif //MESH_BINARY_H_
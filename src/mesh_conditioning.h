@@ -0,0 +1,246 @@
+#ifndef MESH_CONDITIONING_H_
+#define MESH_CONDITIONING_H_
+
+#include <vector>
+#include <array>
+#include <tuple>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <climits>
+#include <algorithm>
+//
+#include "Eigen/Core"
+#include "mesh_topology.h"
+
+namespace acg {
+
+/**
+ * merge the vertices closer than `epsilon`. The vertices are registered to a uniform grid of cells of
+ * the size `epsilon` (or larger if the grid is too fine), and the cells are found through a hash table,
+ * so each vertex only compares against the vertices in the 27 cells around it.
+ * The vertices are visited in the order of the input, and a vertex is merged into the first earlier vertex kept
+ * within `epsilon`, so the result does not depend on the hash.
+ * @param epsilon distance within which the vertices are merged
+ * @return index of the merged vertex for each input vertex, and the number of the merged vertices.
+ * The merged vertices keep the order of their first occurrences
+ */
+inline std::pair<std::vector<unsigned int>, unsigned int> weld_vertices(
+    const Eigen::Ref<const Eigen::Matrix3Xf> &vtx2xyz,
+    float epsilon) {
+  const auto num_vtx = static_cast<unsigned int>(vtx2xyz.cols());
+  std::vector<unsigned int> vtx2new(num_vtx, UINT_MAX);
+  if (num_vtx == 0) { return {vtx2new, 0}; }
+  const Eigen::Vector3f pmin = vtx2xyz.rowwise().minCoeff();
+  const Eigen::Vector3f pmax = vtx2xyz.rowwise().maxCoeff();
+  constexpr float max_num_cell = float(1u << 20); // 20 bits for each axis of the key
+  const float cell_size = std::max({epsilon, (pmax - pmin).maxCoeff() / (max_num_cell - 2.f), 1.0e-30f});
+  const auto cell_of = [&](unsigned int i_vtx) -> Eigen::Vector3i {
+    return ((vtx2xyz.col(i_vtx) - pmin) / cell_size).array().floor().cast<int>() + 1; // +1 for the neighbor cells
+  };
+  const auto key_of = [](const Eigen::Vector3i &c) {
+    return (std::uint64_t(c.x()) << 42) | (std::uint64_t(c.y()) << 21) | std::uint64_t(c.z());
+  };
+  // vertices sorted by the cells, so the vertices of a cell are contiguous
+  std::vector<std::uint64_t> keys(num_vtx);
+  std::vector<unsigned int> sorted2vtx(num_vtx);
+  for (unsigned int i_vtx = 0; i_vtx < num_vtx; ++i_vtx) {
+    keys[i_vtx] = key_of(cell_of(i_vtx));
+    sorted2vtx[i_vtx] = i_vtx;
+  }
+  radix_sort_key_value(keys, sorted2vtx);
+  // open addressing hash table from the key of a cell to the first sorted vertex in the cell
+  unsigned int num_bit = 1;
+  while ((1u << num_bit) < num_vtx * 2) { ++num_bit; }
+  const unsigned int mask = (1u << num_bit) - 1;
+  const auto hash = [&](std::uint64_t key) {
+    return static_cast<unsigned int>((key * 0x9E3779B97F4A7C15ull) >> (64 - num_bit));
+  };
+  std::vector<std::uint64_t> slot2key(mask + 1, UINT64_MAX);
+  std::vector<unsigned int> slot2sorted(mask + 1, 0);
+  for (unsigned int i = 0; i < num_vtx; ++i) {
+    if (i > 0 && keys[i] == keys[i - 1]) { continue; }
+    unsigned int slot = hash(keys[i]);
+    while (slot2key[slot] != UINT64_MAX) { slot = (slot + 1) & mask; }
+    slot2key[slot] = keys[i];
+    slot2sorted[slot] = i;
+  }
+  const float eps2 = epsilon * epsilon;
+  std::vector<unsigned char> vtx2kept(num_vtx, 0); // the vertex is not merged into another
+  unsigned int num_new = 0;
+  for (unsigned int i_vtx = 0; i_vtx < num_vtx; ++i_vtx) {
+    const Eigen::Vector3i c = cell_of(i_vtx);
+    unsigned int j_min = UINT_MAX; // earliest kept vertex within epsilon
+    for (int dz = -1; dz <= 1; ++dz) {
+      for (int dy = -1; dy <= 1; ++dy) {
+        for (int dx = -1; dx <= 1; ++dx) {
+          const std::uint64_t key = key_of(c + Eigen::Vector3i(dx, dy, dz));
+          unsigned int slot = hash(key);
+          while (slot2key[slot] != UINT64_MAX && slot2key[slot] != key) { slot = (slot + 1) & mask; }
+          if (slot2key[slot] != key) { continue; }
+          for (unsigned int i = slot2sorted[slot]; i < num_vtx && keys[i] == key; ++i) {
+            const unsigned int j_vtx = sorted2vtx[i];
+            if (j_vtx >= i_vtx || j_vtx >= j_min || !vtx2kept[j_vtx]) { continue; }
+            if ((vtx2xyz.col(j_vtx) - vtx2xyz.col(i_vtx)).squaredNorm() > eps2) { continue; }
+            j_min = j_vtx;
+          }
+        }
+      }
+    }
+    if (j_min != UINT_MAX) {
+      vtx2new[i_vtx] = vtx2new[j_min];
+    } else {
+      vtx2new[i_vtx] = num_new++;
+      vtx2kept[i_vtx] = 1;
+    }
+  }
+  return {vtx2new, num_new};
+}
+
+/**
+ * weld the vertices, then remove the degenerate triangles (repeated vertex or zero area),
+ * the duplicated triangles (same vertices in the same cyclic order) and the vertices not used by any triangle.
+ * @param epsilon distance within which the vertices are merged (negative: no welding)
+ * @return vertex indices of the triangles and coordinates of the vertices after the conditioning
+ */
+inline auto condition_triangle_mesh(
+    const Eigen::Ref<const Eigen::Matrix<unsigned int, 3, Eigen::Dynamic>> &tri2vtx,
+    const Eigen::Ref<const Eigen::Matrix3Xf> &vtx2xyz,
+    float epsilon)
+-> std::tuple<Eigen::Matrix<unsigned int, 3, Eigen::Dynamic>, Eigen::Matrix3Xf> {
+  const auto num_vtx = static_cast<unsigned int>(vtx2xyz.cols());
+  std::vector<unsigned int> vtx2weld(num_vtx);
+  unsigned int num_weld = num_vtx;
+  if (epsilon >= 0.f) {
+    std::tie(vtx2weld, num_weld) = weld_vertices(vtx2xyz, epsilon);
+  } else {
+    for (unsigned int i_vtx = 0; i_vtx < num_vtx; ++i_vtx) { vtx2weld[i_vtx] = i_vtx; }
+  }
+  Eigen::Matrix3Xf weld2xyz(3, num_weld);
+  for (unsigned int i_vtx = num_vtx; i_vtx-- > 0;) { weld2xyz.col(vtx2weld[i_vtx]) = vtx2xyz.col(i_vtx); } // first
+  // triangles rotated so that the smallest index comes first, which keeps the orientation
+  std::vector<std::array<unsigned int, 4>> tris; // {i0, i1, i2, index of the input triangle}
+  for (unsigned int i_tri = 0; i_tri < tri2vtx.cols(); ++i_tri) {
+    std::array<unsigned int, 3> t = {vtx2weld[tri2vtx(0, i_tri)], vtx2weld[tri2vtx(1, i_tri)], vtx2weld[tri2vtx(2, i_tri)]};
+    if (t[0] == t[1] || t[1] == t[2] || t[2] == t[0]) { continue; }
+    const Eigen::Vector3f p0 = weld2xyz.col(t[0]), p1 = weld2xyz.col(t[1]), p2 = weld2xyz.col(t[2]);
+    if ((p1 - p0).cross(p2 - p0).squaredNorm() == 0.f) { continue; }
+    std::rotate(t.begin(), std::min_element(t.begin(), t.end()), t.end());
+    tris.push_back({t[0], t[1], t[2], i_tri});
+  }
+  std::sort(tris.begin(), tris.end());
+  std::vector<std::array<unsigned int, 4>> tris_unique;
+  for (unsigned int i = 0; i < tris.size(); ++i) {
+    if (i > 0 && std::equal(tris[i].begin(), tris[i].begin() + 3, tris[i - 1].begin())) { continue; }
+    tris_unique.push_back(tris[i]);
+  }
+  std::sort(tris_unique.begin(), tris_unique.end(), [](const auto &a, const auto &b) { return a[3] < b[3]; });
+  // remove the vertices without triangles keeping the order of the vertices
+  std::vector<unsigned int> weld2new(num_weld, UINT_MAX);
+  for (const auto &t: tris_unique) { weld2new[t[0]] = weld2new[t[1]] = weld2new[t[2]] = 0; }
+  unsigned int num_new = 0;
+  for (unsigned int iw = 0; iw < num_weld; ++iw) { if (weld2new[iw] == 0) { weld2new[iw] = num_new++; } }
+  Eigen::Matrix<unsigned int, 3, Eigen::Dynamic> tri2new(3, tris_unique.size());
+  for (unsigned int i_tri = 0; i_tri < tris_unique.size(); ++i_tri) {
+    const auto &t = tris_unique[i_tri];
+    // restore the input rotation of the corners so the first corner of each triangle stays the same
+    const unsigned int i_org = t[3];
+    const unsigned int r = (vtx2weld[tri2vtx(0, i_org)] == t[0]) ? 0 : (vtx2weld[tri2vtx(0, i_org)] == t[1] ? 1 : 2);
+    for (unsigned int i_node = 0; i_node < 3; ++i_node) { tri2new(i_node, i_tri) = weld2new[t[(i_node + r) % 3]]; }
+  }
+  Eigen::Matrix3Xf new2xyz(3, num_new);
+  for (unsigned int iw = 0; iw < num_weld; ++iw) {
+    if (weld2new[iw] != UINT_MAX) { new2xyz.col(weld2new[iw]) = weld2xyz.col(iw); }
+  }
+  return std::make_tuple(tri2new, new2xyz);
+}
+
+/**
+ * Index buffer with 16-bit indices when all the indices fit, otherwise 32-bit.
+ * The bytes can be uploaded as they are (e.g., GL_UNSIGNED_SHORT or GL_UNSIGNED_INT).
+ */
+class CompactIndexBuffer {
+ public:
+  unsigned int bytes_per_index = 4; // 2 or 4
+  std::vector<unsigned char> data;
+ public:
+  explicit CompactIndexBuffer(const Eigen::Ref<const Eigen::Matrix<unsigned int, 3, Eigen::Dynamic>> &tri2vtx) {
+    const auto num_index = static_cast<size_t>(tri2vtx.size());
+    const unsigned int max_index = num_index == 0 ? 0 : tri2vtx.maxCoeff();
+    bytes_per_index = max_index <= 0xffffu ? 2 : 4;
+    data.resize(num_index * bytes_per_index);
+    for (size_t i = 0; i < num_index; ++i) {
+      if (bytes_per_index == 2) {
+        const auto v = static_cast<std::uint16_t>(tri2vtx.data()[i]);
+        std::memcpy(data.data() + i * 2, &v, 2);
+      } else {
+        const std::uint32_t v = tri2vtx.data()[i];
+        std::memcpy(data.data() + i * 4, &v, 4);
+      }
+    }
+  }
+
+  [[nodiscard]] size_t size() const { return data.size() / bytes_per_index; }
+
+  [[nodiscard]] unsigned int operator[](size_t i) const {
+    if (bytes_per_index == 2) {
+      std::uint16_t v;
+      std::memcpy(&v, data.data() + i * 2, 2);
+      return v;
+    }
+    std::uint32_t v;
+    std::memcpy(&v, data.data() + i * 4, 4);
+    return v;
+  }
+};
+
+/**
+ * encode the indices for the storage. Each index is stored as the difference from the previous index,
+ * mapped to an unsigned integer by the zigzag encoding (0,-1,1,-2,... -> 0,1,2,3,...) and written as a
+ * variable-length integer (7 bits per byte). The neighboring triangles share close indices,
+ * so most differences take one or two bytes.
+ * @return bytes of the encoded indices
+ */
+inline std::vector<unsigned char> encode_indices_delta_varint(const std::vector<unsigned int> &indices) {
+  std::vector<unsigned char> bytes;
+  bytes.reserve(indices.size() * 2);
+  std::int64_t prev = 0;
+  for (unsigned int index: indices) {
+    const std::int64_t delta = std::int64_t(index) - prev;
+    prev = index;
+    auto v = (static_cast<std::uint64_t>(delta) << 1) ^ static_cast<std::uint64_t>(delta >> 63); // zigzag
+    while (v >= 0x80) {
+      bytes.push_back(static_cast<unsigned char>(v | 0x80));
+      v >>= 7;
+    }
+    bytes.push_back(static_cast<unsigned char>(v));
+  }
+  return bytes;
+}
+
+/**
+ * decode the indices encoded by `encode_indices_delta_varint`
+ * @return decoded indices (the indices decoded before the end if the bytes are truncated)
+ */
+inline std::vector<unsigned int> decode_indices_delta_varint(const std::vector<unsigned char> &bytes) {
+  std::vector<unsigned int> indices;
+  std::int64_t prev = 0;
+  for (size_t pos = 0; pos < bytes.size();) {
+    std::uint64_t v = 0;
+    unsigned int shift = 0;
+    while (pos < bytes.size() && (bytes[pos] & 0x80) && shift < 63) {
+      v |= std::uint64_t(bytes[pos++] & 0x7f) << shift;
+      shift += 7;
+    }
+    if (pos == bytes.size()) { break; }
+    v |= std::uint64_t(bytes[pos++]) << shift;
+    const auto delta = static_cast<std::int64_t>(v >> 1) ^ -static_cast<std::int64_t>(v & 1);
+    prev += delta;
+    indices.push_back(static_cast<unsigned int>(prev));
+  }
+  return indices;
+}
+
+} // namespace acg
+
+#endif //MESH_CONDITIONING_H_
@@ -0,0 +1,249 @@
+#ifndef MESH_OPTIMIZE_H_
+#define MESH_OPTIMIZE_H_
+
+#include <vector>
+#include <array>
+#include <cmath>
+#include <climits>
+#include <numeric>
+#include <algorithm>
+//
+#include "Eigen/Core"
+#include "util_triangle_mesh.h"
+
+namespace acg {
+
+/**
+ * Efficiency of the post-transform vertex cache for a triangle order
+ */
+class VertexCacheStatistics {
+ public:
+  float acmr = 0.f; // average cache miss ratio: transformed vertices per triangle (0.5 at best, 3 at worst)
+  float atvr = 0.f; // average transformed vertex ratio: transformed vertices per vertex (1 at best)
+};
+
+/**
+ * simulate a FIFO cache of the transformed vertices, as the hardware does
+ * @param cache_size number of the vertices in the cache
+ */
+inline VertexCacheStatistics vertex_cache_statistics(
+    const Eigen::Ref<const Eigen::Matrix<unsigned int, 3, Eigen::Dynamic>> &tri2vtx,
+    unsigned int num_vtx,
+    unsigned int cache_size = 16) {
+  std::vector<unsigned int> vtx2time(num_vtx, 0); // time when the vertex entered the cache
+  unsigned int time = cache_size + 1; // vertices entered before `time - cache_size` are evicted
+  unsigned int num_miss = 0;
+  for (unsigned int i = 0; i < tri2vtx.size(); ++i) {
+    const unsigned int i_vtx = tri2vtx.data()[i];
+    if (time - vtx2time[i_vtx] > cache_size) {
+      vtx2time[i_vtx] = time++;
+      num_miss += 1;
+    }
+  }
+  VertexCacheStatistics stat;
+  stat.acmr = tri2vtx.cols() > 0 ? float(num_miss) / float(tri2vtx.cols()) : 0.f;
+  stat.atvr = num_vtx > 0 ? float(num_miss) / float(num_vtx) : 0.f;
+  return stat;
+}
+
+/**
+ * reorder the triangles for the post-transform vertex cache by the greedy method of Forsyth.
+ * Each vertex has a score from its position in a simulated LRU cache and the number of its remaining triangles,
+ * and the triangle with the highest sum of the scores of its vertices is emitted next.
+ * Only the triangles around the vertices in the cache are rescored after each step.
+ * @param cache_size size of the simulated cache (larger than the hardware cache, as the method is not sensitive to it)
+ * @return triangles in the new order
+ */
+inline auto optimize_vertex_cache(
+    const Eigen::Ref<const Eigen::Matrix<unsigned int, 3, Eigen::Dynamic>> &tri2vtx,
+    unsigned int num_vtx,
+    unsigned int cache_size = 32) -> Eigen::Matrix<unsigned int, 3, Eigen::Dynamic> {
+  const auto num_tri = static_cast<unsigned int>(tri2vtx.cols());
+  const auto[vtx2idx, idx2corner] = vtx2corner_of_triangle_mesh(tri2vtx, num_vtx);
+  std::vector<unsigned int> vtx2valence(num_vtx); // number of the triangles not emitted yet
+  for (unsigned int i_vtx = 0; i_vtx < num_vtx; ++i_vtx) { vtx2valence[i_vtx] = vtx2idx[i_vtx + 1] - vtx2idx[i_vtx]; }
+  std::vector<int> vtx2pos(num_vtx, -1); // position in the cache (-1: not in the cache)
+  const auto score_of_vertex = [&](unsigned int i_vtx) {
+    if (vtx2valence[i_vtx] == 0) { return -1.f; } // nothing left to draw
+    float score = 0.f;
+    const int pos = vtx2pos[i_vtx];
+    if (pos >= 0 && pos < 3) {
+      score = 0.75f; // used by the last triangle: a fixed score avoids the strips in one direction
+    } else if (pos >= 3) {
+      score = std::pow(1.f - float(pos - 3) / float(cache_size - 3), 1.5f);
+    }
+    return score + 2.f / std::sqrt(float(vtx2valence[i_vtx])); // prefer the vertices with few triangles left
+  };
+  std::vector<float> vtx2score(num_vtx);
+  for (unsigned int i_vtx = 0; i_vtx < num_vtx; ++i_vtx) { vtx2score[i_vtx] = score_of_vertex(i_vtx); }
+  std::vector<float> tri2score(num_tri);
+  for (unsigned int i_tri = 0; i_tri < num_tri; ++i_tri) {
+    tri2score[i_tri] = vtx2score[tri2vtx(0, i_tri)] + vtx2score[tri2vtx(1, i_tri)] + vtx2score[tri2vtx(2, i_tri)];
+  }
+  std::vector<unsigned char> tri2emitted(num_tri, 0);
+  std::vector<unsigned int> cache, cache_new;
+  Eigen::Matrix<unsigned int, 3, Eigen::Dynamic> tri2vtx_new(3, num_tri);
+  unsigned int i_tri_best = num_tri == 0 ? UINT_MAX : static_cast<unsigned int>(
+      std::max_element(tri2score.begin(), tri2score.end()) - tri2score.begin());
+  unsigned int i_tri_scan = 0; // triangles before this are emitted (for the restart when the cache has no candidate)
+  for (unsigned int i_out = 0; i_out < num_tri; ++i_out) {
+    if (i_tri_best == UINT_MAX) { // restart from the first triangle not emitted yet
+      while (tri2emitted[i_tri_scan]) { ++i_tri_scan; }
+      i_tri_best = i_tri_scan;
+    }
+    const unsigned int i_tri = i_tri_best;
+    tri2emitted[i_tri] = 1;
+    tri2vtx_new.col(i_out) = tri2vtx.col(i_tri);
+    // move the vertices of the triangle to the front of the cache
+    cache_new.assign(tri2vtx.col(i_tri).data(), tri2vtx.col(i_tri).data() + 3);
+    for (unsigned int i_vtx: cache) {
+      if (i_vtx != tri2vtx(0, i_tri) && i_vtx != tri2vtx(1, i_tri) && i_vtx != tri2vtx(2, i_tri)) {
+        cache_new.push_back(i_vtx);
+      }
+    }
+    for (unsigned int i_node = 0; i_node < 3; ++i_node) { vtx2valence[tri2vtx(i_node, i_tri)] -= 1; }
+    for (unsigned int pos = 0; pos < cache_new.size(); ++pos) {
+      vtx2pos[cache_new[pos]] = pos < cache_size ? int(pos) : -1; // evicted if beyond the size
+    }
+    // rescore the vertices in the cache (including the evicted ones) and their triangles
+    for (unsigned int i_vtx: cache_new) { vtx2score[i_vtx] = score_of_vertex(i_vtx); }
+    i_tri_best = UINT_MAX;
+    float score_best = -1.f;
+    for (unsigned int i_vtx: cache_new) {
+      for (unsigned int idx = vtx2idx[i_vtx]; idx < vtx2idx[i_vtx + 1]; ++idx) {
+        const unsigned int j_tri = idx2corner[idx] / 3;
+        if (tri2emitted[j_tri]) { continue; }
+        tri2score[j_tri] = vtx2score[tri2vtx(0, j_tri)] + vtx2score[tri2vtx(1, j_tri)] + vtx2score[tri2vtx(2, j_tri)];
+        if (tri2score[j_tri] > score_best) {
+          score_best = tri2score[j_tri];
+          i_tri_best = j_tri;
+        }
+      }
+    }
+    if (cache_new.size() > cache_size) { cache_new.resize(cache_size); }
+    cache.swap(cache_new);
+  }
+  return tri2vtx_new;
+}
+
+/**
+ * reorder the clusters of the triangles to reduce the overdraw while keeping the cache efficiency inside the clusters.
+ * The order from `optimize_vertex_cache` is split where a triangle misses the cache for all its vertices
+ * (the cache is refilled there anyway), or where the cluster so far has a cache miss ratio close to that of
+ * the whole mesh, so that the refill at the start of each reordered cluster costs little.
+ * The clusters facing outward from the center of the mesh are drawn first,
+ * so they are likely to occlude the others when the mesh is seen from any direction.
+ * @param tri2vtx triangles in the order optimized for the vertex cache
+ * @param threshold the clusters are cut when their cache miss ratio is below `threshold` times that of the mesh
+ * @param min_cluster_size minimum number of the triangles in a cluster
+ * @return triangles in the new order
+ */
+inline auto optimize_overdraw(
+    const Eigen::Ref<const Eigen::Matrix<unsigned int, 3, Eigen::Dynamic>> &tri2vtx,
+    const Eigen::Ref<const Eigen::Matrix3Xf> &vtx2xyz,
+    float threshold = 1.05f,
+    unsigned int min_cluster_size = 64,
+    unsigned int cache_size = 16) -> Eigen::Matrix<unsigned int, 3, Eigen::Dynamic> {
+  const auto num_tri = static_cast<unsigned int>(tri2vtx.cols());
+  // split into the clusters by simulating the FIFO cache
+  std::vector<unsigned int> cluster2tri = {0}; // first triangle of each cluster
+  {
+    const float acmr = vertex_cache_statistics(tri2vtx, static_cast<unsigned int>(vtx2xyz.cols()), cache_size).acmr;
+    std::vector<unsigned int> vtx2time(vtx2xyz.cols(), 0);
+    unsigned int time = cache_size + 1;
+    unsigned int num_miss_cluster = 0;
+    for (unsigned int i_tri = 0; i_tri < num_tri; ++i_tri) {
+      unsigned int num_miss = 0;
+      for (unsigned int i_node = 0; i_node < 3; ++i_node) {
+        const unsigned int i_vtx = tri2vtx(i_node, i_tri);
+        if (time - vtx2time[i_vtx] > cache_size) {
+          vtx2time[i_vtx] = time++;
+          num_miss += 1;
+        }
+      }
+      const unsigned int size_cluster = i_tri - cluster2tri.back();
+      if (size_cluster >= min_cluster_size
+          && (num_miss == 3 || float(num_miss_cluster) <= threshold * acmr * float(size_cluster))) {
+        cluster2tri.push_back(i_tri);
+        num_miss_cluster = 0;
+      }
+      num_miss_cluster += num_miss;
+    }
+    cluster2tri.push_back(num_tri);
+  }
+  const auto num_cluster = static_cast<unsigned int>(cluster2tri.size() - 1);
+  // the area-weighted centroid and normal of each cluster
+  Eigen::Vector3f center = Eigen::Vector3f::Zero();
+  float area_sum = 0.f;
+  std::vector<Eigen::Vector3f> cluster2center(num_cluster, Eigen::Vector3f::Zero());
+  std::vector<Eigen::Vector3f> cluster2normal(num_cluster, Eigen::Vector3f::Zero());
+  for (unsigned int i_cluster = 0; i_cluster < num_cluster; ++i_cluster) {
+    float area_cluster = 0.f;
+    for (unsigned int i_tri = cluster2tri[i_cluster]; i_tri < cluster2tri[i_cluster + 1]; ++i_tri) {
+      const Eigen::Vector3f p0 = vtx2xyz.col(tri2vtx(0, i_tri));
+      const Eigen::Vector3f p1 = vtx2xyz.col(tri2vtx(1, i_tri));
+      const Eigen::Vector3f p2 = vtx2xyz.col(tri2vtx(2, i_tri));
+      const Eigen::Vector3f n = (p1 - p0).cross(p2 - p0); // twice the area times the unit normal
+      const float area = n.norm();
+      cluster2center[i_cluster] += (p0 + p1 + p2) / 3.f * area;
+      cluster2normal[i_cluster] += n;
+      area_cluster += area;
+    }
+    center += cluster2center[i_cluster];
+    area_sum += area_cluster;
+    if (area_cluster > 0.f) { cluster2center[i_cluster] /= area_cluster; }
+    cluster2normal[i_cluster].normalize();
+  }
+  if (area_sum > 0.f) { center /= area_sum; }
+  std::vector<float> cluster2key(num_cluster);
+  for (unsigned int i_cluster = 0; i_cluster < num_cluster; ++i_cluster) {
+    cluster2key[i_cluster] = (cluster2center[i_cluster] - center).dot(cluster2normal[i_cluster]);
+  }
+  std::vector<unsigned int> order(num_cluster);
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [&](unsigned int a, unsigned int b) {
+    return cluster2key[a] > cluster2key[b];
+  });
+  Eigen::Matrix<unsigned int, 3, Eigen::Dynamic> tri2vtx_new(3, num_tri);
+  unsigned int i_out = 0;
+  for (unsigned int i_cluster: order) {
+    for (unsigned int i_tri = cluster2tri[i_cluster]; i_tri < cluster2tri[i_cluster + 1]; ++i_tri) {
+      tri2vtx_new.col(i_out++) = tri2vtx.col(i_tri);
+    }
+  }
+  return tri2vtx_new;
+}
+
+/**
+ * renumber the vertices in the order of their first use by the triangles, so the vertex data is fetched
+ * almost sequentially. The unused vertices are moved to the end.
+ * @param tri2vtx (in/out) vertex indices of the triangles, which are renumbered
+ * @return new index of each vertex. Apply it to the vertex attributes with `permute_vertices`
+ */
+inline std::vector<unsigned int> optimize_vertex_fetch(
+    Eigen::Matrix<unsigned int, 3, Eigen::Dynamic> &tri2vtx,
+    unsigned int num_vtx) {
+  std::vector<unsigned int> vtx2new(num_vtx, UINT_MAX);
+  unsigned int num_new = 0;
+  for (unsigned int i = 0; i < tri2vtx.size(); ++i) {
+    unsigned int &i_vtx = tri2vtx.data()[i];
+    if (vtx2new[i_vtx] == UINT_MAX) { vtx2new[i_vtx] = num_new++; }
+    i_vtx = vtx2new[i_vtx];
+  }
+  for (unsigned int &i: vtx2new) { if (i == UINT_MAX) { i = num_new++; } }
+  return vtx2new;
+}
+
+/**
+ * move the columns of the vertex attributes to their new indices
+ */
+template<typename MAT>
+MAT permute_vertices(const MAT &vtx2attr, const std::vector<unsigned int> &vtx2new) {
+  MAT vtx2attr_new(vtx2attr.rows(), vtx2attr.cols());
+  for (unsigned int i_vtx = 0; i_vtx < vtx2new.size(); ++i_vtx) { vtx2attr_new.col(vtx2new[i_vtx]) = vtx2attr.col(i_vtx); }
+  return vtx2attr_new;
+}
+
+} // namespace acg
+
+#endif //MESH_OPTIMIZE_H_
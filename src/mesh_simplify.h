@@ -0,0 +1,450 @@
+#ifndef MESH_SIMPLIFY_H_
+#define MESH_SIMPLIFY_H_
+
+#include <vector>
+#include <array>
+#include <cmath>
+#include <cfloat>
+#include <climits>
+#include <queue>
+#include <optional>
+#include <algorithm>
+//
+#include "Eigen/Dense"
+#include "mesh_topology.h"
+#include "mesh_conditioning.h"
+
+namespace acg {
+
+/**
+ * Quadric error of Garland and Heckbert: the weighted sum of the squared distances from a point to a set of planes,
+ * Q(x) = x^T A x + 2 b^T x + c. The quadric of two vertices is the sum of their quadrics.
+ */
+class Quadric {
+ public:
+  Eigen::Matrix3d A = Eigen::Matrix3d::Zero();
+  Eigen::Vector3d b = Eigen::Vector3d::Zero();
+  double c = 0.;
+  double weight = 0.; // sum of the weights of the planes
+ public:
+  /**
+   * @param n unit normal of the plane n.x + d = 0
+   */
+  static Quadric of_plane(const Eigen::Vector3d &n, double d, double weight) {
+    Quadric q;
+    q.A = weight * n * n.transpose();
+    q.b = weight * d * n;
+    q.c = weight * d * d;
+    q.weight = weight;
+    return q;
+  }
+
+  Quadric &operator+=(const Quadric &q) {
+    A += q.A;
+    b += q.b;
+    c += q.c;
+    weight += q.weight;
+    return *this;
+  }
+
+  /**
+   * @return mean squared distance to the planes
+   */
+  [[nodiscard]] double error(const Eigen::Vector3d &x) const {
+    if (weight <= 0.) { return 0.; }
+    return std::max(0., x.dot(A * x) + 2. * b.dot(x) + c) / weight;
+  }
+
+  /**
+   * @return point minimizing the error, or nullopt if the planes do not determine a point (e.g., on a flat region)
+   */
+  [[nodiscard]] std::optional<Eigen::Vector3d> minimizer() const {
+    if (weight <= 0.) { return std::nullopt; }
+    const Eigen::Matrix3d a = A / weight;
+    if (std::abs(a.determinant()) < 1.0e-6) { return std::nullopt; } // the eigenvalues of `a` sum to one
+    return Eigen::Vector3d(a.inverse() * (-b / weight));
+  }
+};
+
+/**
+ * distance from a point to a triangle (the closest point is found by the Voronoi regions of the triangle)
+ */
+inline float distance_point_triangle(
+    const Eigen::Vector3f &p,
+    const Eigen::Vector3f &a,
+    const Eigen::Vector3f &b,
+    const Eigen::Vector3f &c) {
+  const Eigen::Vector3f ab = b - a, ac = c - a, ap = p - a;
+  const float d1 = ab.dot(ap), d2 = ac.dot(ap);
+  if (d1 <= 0.f && d2 <= 0.f) { return ap.norm(); } // vertex a
+  const Eigen::Vector3f bp = p - b;
+  const float d3 = ab.dot(bp), d4 = ac.dot(bp);
+  if (d3 >= 0.f && d4 <= d3) { return bp.norm(); } // vertex b
+  const Eigen::Vector3f cp = p - c;
+  const float d5 = ab.dot(cp), d6 = ac.dot(cp);
+  if (d6 >= 0.f && d5 <= d6) { return cp.norm(); } // vertex c
+  const float vc = d1 * d4 - d3 * d2;
+  if (vc <= 0.f && d1 >= 0.f && d3 <= 0.f) { return (ap - ab * (d1 / (d1 - d3))).norm(); } // edge ab
+  const float vb = d5 * d2 - d1 * d6;
+  if (vb <= 0.f && d2 >= 0.f && d6 <= 0.f) { return (ap - ac * (d2 / (d2 - d6))).norm(); } // edge ac
+  const float va = d3 * d6 - d5 * d4;
+  if (va <= 0.f && d4 - d3 >= 0.f && d5 - d6 >= 0.f) { // edge bc
+    return (bp - (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)))).norm();
+  }
+  const float denom = 1.f / (va + vb + vc);
+  return (ap - ab * (vb * denom) - ac * (vc * denom)).norm(); // inside the face
+}
+
+/**
+ * Level of detail of a triangle mesh
+ */
+class MeshLod {
+ public:
+  Eigen::Matrix<unsigned int, 3, Eigen::Dynamic> tri2vtx;
+  Eigen::Matrix3Xf vtx2xyz;
+  Eigen::MatrixXf vtx2attr; // attributes of the vertices (one column per vertex, or empty)
+  std::vector<unsigned int> src2vtx; // vertex each vertex of the source mesh is collapsed into (UINT_MAX if unused)
+  float error = 0.f; // largest distance from the vertices of the source mesh to the triangles of this level
+};
+
+/**
+ * upper bound of the distance from the vertices of a source mesh to a simplified mesh.
+ * Each source vertex is measured against the triangles around the vertex it is collapsed into, instead of
+ * all the triangles, so the distance is never underestimated and costs only a few triangles per vertex.
+ * @param vtx2xyz_src coordinates of the vertices of the source mesh
+ * @param src2vtx vertex of the simplified mesh each source vertex is collapsed into (UINT_MAX to skip)
+ */
+inline float deviation_of_simplified_mesh(
+    const Eigen::Ref<const Eigen::Matrix3Xf> &vtx2xyz_src,
+    const std::vector<unsigned int> &src2vtx,
+    const Eigen::Ref<const Eigen::Matrix<unsigned int, 3, Eigen::Dynamic>> &tri2vtx,
+    const Eigen::Ref<const Eigen::Matrix3Xf> &vtx2xyz) {
+  const auto[vtx2idx, idx2corner] = vtx2corner_of_triangle_mesh(tri2vtx, static_cast<unsigned int>(vtx2xyz.cols()));
+  float deviation = 0.f;
+  for (unsigned int i_src = 0; i_src < src2vtx.size(); ++i_src) {
+    const unsigned int i_vtx = src2vtx[i_src];
+    if (i_vtx == UINT_MAX) { continue; }
+    float dist = FLT_MAX;
+    for (unsigned int idx = vtx2idx[i_vtx]; idx < vtx2idx[i_vtx + 1]; ++idx) {
+      const unsigned int i_tri = idx2corner[idx] / 3;
+      dist = std::min(dist, distance_point_triangle(
+          vtx2xyz_src.col(i_src),
+          vtx2xyz.col(tri2vtx(0, i_tri)), vtx2xyz.col(tri2vtx(1, i_tri)), vtx2xyz.col(tri2vtx(2, i_tri))));
+    }
+    if (dist != FLT_MAX) { deviation = std::max(deviation, dist); }
+  }
+  return deviation;
+}
+
+/**
+ * simplify a triangle mesh by collapsing the edges in the order of the quadric error.
+ * The candidates are kept in a priority queue and never updated in place: a collapse stamps its vertex,
+ * and the candidates with the old stamps are discarded when they come to the top (lazy deletion).
+ * The boundary edges add the planes perpendicular to the triangles, so the boundaries keep their shape.
+ * The vertices sharing a position with another vertex (seams of the attributes such as the texture coordinates)
+ * are never removed, so the seams do not open. The attributes of the collapsed vertex are interpolated along the edge.
+ * A collapse is rejected if it makes the mesh non-manifold or flips a triangle, and the edges around the vertices
+ * whose triangles changed are queued again, so a rejected collapse is retried when its neighborhood changes.
+ * @param vtx2attr attributes of the vertices (one column per vertex, or empty)
+ * @param num_tri_target number of the triangles to reduce to
+ * @param max_error the simplification stops before the collapse whose quadric error (RMS distance to the planes)
+ * is larger
+ * @return simplified mesh, whose vertices keep the order of the input. Its `error` is the deviation of the input
+ * vertices measured by `deviation_of_simplified_mesh`
+ */
+inline MeshLod simplify_triangle_mesh(
+    const Eigen::Ref<const Eigen::Matrix<unsigned int, 3, Eigen::Dynamic>> &tri2vtx,
+    const Eigen::Ref<const Eigen::Matrix3Xf> &vtx2xyz,
+    const Eigen::Ref<const Eigen::MatrixXf> &vtx2attr,
+    unsigned int num_tri_target,
+    float max_error = FLT_MAX) {
+  constexpr double boundary_weight = 2.;
+  const auto num_vtx = static_cast<unsigned int>(vtx2xyz.cols());
+  const auto num_tri = static_cast<unsigned int>(tri2vtx.cols());
+  const bool is_attr = vtx2attr.cols() == num_vtx && vtx2attr.rows() > 0;
+  const MeshTopology topology(tri2vtx, num_vtx);
+  Eigen::Matrix<unsigned int, 3, Eigen::Dynamic> tri2vtx_work = tri2vtx;
+  Eigen::Matrix3Xf vtx2xyz_work = vtx2xyz;
+  Eigen::MatrixXf vtx2attr_work = is_attr ? Eigen::MatrixXf(vtx2attr) : Eigen::MatrixXf();
+  // quadrics of the planes of the triangles weighted by the area, and of the boundary edges
+  std::vector<Quadric> vtx2quadric(num_vtx);
+  for (unsigned int i_tri = 0; i_tri < num_tri; ++i_tri) {
+    const Eigen::Vector3d p0 = vtx2xyz.col(tri2vtx(0, i_tri)).cast<double>();
+    const Eigen::Vector3d p1 = vtx2xyz.col(tri2vtx(1, i_tri)).cast<double>();
+    const Eigen::Vector3d p2 = vtx2xyz.col(tri2vtx(2, i_tri)).cast<double>();
+    const Eigen::Vector3d n = (p1 - p0).cross(p2 - p0);
+    const double area2 = n.norm();
+    if (area2 == 0.) { continue; }
+    const Eigen::Vector3d un = n / area2;
+    const Quadric q = Quadric::of_plane(un, -un.dot(p0), area2 * 0.5);
+    for (unsigned int i_node = 0; i_node < 3; ++i_node) {
+      vtx2quadric[tri2vtx(i_node, i_tri)] += q;
+      const unsigned int he = i_tri * 3 + i_node;
+      if (!topology.is_boundary(he)) { continue; }
+      const Eigen::Vector3d e = vtx2xyz.col(topology.target(he)).cast<double>()
+          - vtx2xyz.col(topology.source(he)).cast<double>();
+      const Eigen::Vector3d nb = e.cross(un).normalized();
+      const Quadric qb = Quadric::of_plane(
+          nb, -nb.dot(vtx2xyz.col(topology.source(he)).cast<double>()), boundary_weight * e.squaredNorm());
+      vtx2quadric[topology.source(he)] += qb;
+      vtx2quadric[topology.target(he)] += qb;
+    }
+  }
+  std::vector<unsigned char> vtx2boundary(num_vtx, 0);
+  for (unsigned int he = 0; he < num_tri * 3; ++he) {
+    if (topology.is_boundary(he)) { vtx2boundary[topology.source(he)] = vtx2boundary[topology.target(he)] = 1; }
+  }
+  std::vector<unsigned char> vtx2locked(num_vtx, 0); // vertices on the seams
+  {
+    const auto[vtx2weld, num_weld] = weld_vertices(vtx2xyz, 0.f);
+    std::vector<unsigned int> weld2count(num_weld, 0);
+    for (unsigned int i_vtx = 0; i_vtx < num_vtx; ++i_vtx) { weld2count[vtx2weld[i_vtx]] += 1; }
+    for (unsigned int i_vtx = 0; i_vtx < num_vtx; ++i_vtx) { vtx2locked[i_vtx] = weld2count[vtx2weld[i_vtx]] > 1; }
+  }
+  std::vector<std::vector<unsigned int>> vtx2tri(num_vtx);
+  for (unsigned int i_vtx = 0; i_vtx < num_vtx; ++i_vtx) {
+    for (unsigned int idx = topology.vtx2idx[i_vtx]; idx < topology.vtx2idx[i_vtx + 1]; ++idx) {
+      vtx2tri[i_vtx].push_back(topology.idx2he[idx] / 3);
+    }
+  }
+  std::vector<unsigned char> tri2alive(num_tri, 1);
+  std::vector<unsigned int> vtx2stamp(num_vtx, 0); // incremented when the vertex or its triangles change
+  std::vector<unsigned int> vtx2parent(num_vtx); // vertex collapsed into (itself if alive)
+  for (unsigned int i_vtx = 0; i_vtx < num_vtx; ++i_vtx) { vtx2parent[i_vtx] = i_vtx; }
+  // candidate of the collapse of `i_remove` into `i_keep`
+  class Collapse {
+   public:
+    float error; // quadric error (RMS distance to the planes)
+    unsigned int i_keep, i_remove;
+    unsigned int stamp_keep, stamp_remove;
+    Eigen::Vector3f xyz;
+    float ratio; // position on the edge, from `i_keep` (0) to `i_remove` (1)
+    bool operator<(const Collapse &rhs) const { return error > rhs.error; } // smallest error at the top
+  };
+  const auto collapse_of = [&](unsigned int i_keep, unsigned int i_remove) -> std::optional<Collapse> {
+    if (vtx2locked[i_remove]) { std::swap(i_keep, i_remove); }
+    if (vtx2locked[i_remove]) { return std::nullopt; }
+    Quadric q = vtx2quadric[i_keep];
+    q += vtx2quadric[i_remove];
+    const Eigen::Vector3d p0 = vtx2xyz_work.col(i_keep).cast<double>();
+    const Eigen::Vector3d p1 = vtx2xyz_work.col(i_remove).cast<double>();
+    Eigen::Vector3d x = p0;
+    if (!vtx2locked[i_keep]) {
+      const auto x_opt = q.minimizer();
+      if (x_opt && (*x_opt - (p0 + p1) * 0.5).norm() < (p1 - p0).norm()) { // reject the far point of the thin quadric
+        x = *x_opt;
+      } else {
+        for (const Eigen::Vector3d &xc: {p1, Eigen::Vector3d((p0 + p1) * 0.5)}) {
+          if (q.error(xc) < q.error(x)) { x = xc; }
+        }
+      }
+    }
+    const double len2 = (p1 - p0).squaredNorm();
+    const double ratio = len2 > 0. ? std::clamp((x - p0).dot(p1 - p0) / len2, 0., 1.) : 0.;
+    return Collapse{
+        float(std::sqrt(q.error(x))), i_keep, i_remove, vtx2stamp[i_keep], vtx2stamp[i_remove],
+        x.cast<float>(), float(ratio)};
+  };
+  std::priority_queue<Collapse> queue;
+  for (const auto &e: topology.edge2vtx) {
+    if (const auto c = collapse_of(e[0], e[1])) { queue.push(*c); }
+  }
+  // vertices of the triangles around a vertex other than itself
+  const auto neighbors_of = [&](unsigned int i_vtx, std::vector<unsigned int> &neighbors) {
+    neighbors.clear();
+    for (unsigned int i_tri: vtx2tri[i_vtx]) {
+      for (unsigned int i_node = 0; i_node < 3; ++i_node) {
+        if (tri2vtx_work(i_node, i_tri) != i_vtx) { neighbors.push_back(tri2vtx_work(i_node, i_tri)); }
+      }
+    }
+    std::sort(neighbors.begin(), neighbors.end());
+    neighbors.erase(std::unique(neighbors.begin(), neighbors.end()), neighbors.end());
+  };
+  // the triangle flips when the vertex `i_vtx` moves to `xyz`
+  const auto is_flipped = [&](unsigned int i_tri, unsigned int i_vtx, const Eigen::Vector3f &xyz) {
+    std::array<Eigen::Vector3f, 3> p;
+    for (unsigned int i_node = 0; i_node < 3; ++i_node) { p[i_node] = vtx2xyz_work.col(tri2vtx_work(i_node, i_tri)); }
+    const Eigen::Vector3f n0 = (p[1] - p[0]).cross(p[2] - p[0]);
+    for (unsigned int i_node = 0; i_node < 3; ++i_node) { if (tri2vtx_work(i_node, i_tri) == i_vtx) { p[i_node] = xyz; }}
+    const Eigen::Vector3f n1 = (p[1] - p[0]).cross(p[2] - p[0]);
+    return n0.dot(n1) <= 0.f;
+  };
+  unsigned int num_tri_alive = num_tri;
+  std::vector<unsigned int> shared, neighbors_keep, neighbors_remove, common;
+  while (num_tri_alive > num_tri_target && !queue.empty()) {
+    const Collapse c = queue.top();
+    queue.pop();
+    if (vtx2stamp[c.i_keep] != c.stamp_keep || vtx2stamp[c.i_remove] != c.stamp_remove) { continue; } // outdated
+    if (c.error > max_error) { break; }
+    // triangles sharing the edge
+    shared.clear();
+    for (unsigned int i_tri: vtx2tri[c.i_keep]) {
+      const auto col = tri2vtx_work.col(i_tri);
+      if (col(0) == c.i_remove || col(1) == c.i_remove || col(2) == c.i_remove) { shared.push_back(i_tri); }
+    }
+    if (shared.empty() || shared.size() > 2) { continue; }
+    if (shared.size() == 2 && vtx2boundary[c.i_keep] && vtx2boundary[c.i_remove]) { continue; } // pinches the mesh
+    // link condition: the common neighbors are only the opposite vertices of the shared triangles
+    neighbors_of(c.i_keep, neighbors_keep);
+    neighbors_of(c.i_remove, neighbors_remove);
+    common.clear();
+    std::set_intersection(
+        neighbors_keep.begin(), neighbors_keep.end(), neighbors_remove.begin(), neighbors_remove.end(),
+        std::back_inserter(common));
+    if (common.size() != shared.size()) { continue; }
+    bool is_valid = true;
+    for (unsigned int i_vtx: {c.i_keep, c.i_remove}) {
+      for (unsigned int i_tri: vtx2tri[i_vtx]) {
+        if (std::find(shared.begin(), shared.end(), i_tri) != shared.end()) { continue; }
+        if (is_flipped(i_tri, i_vtx, c.xyz)) { is_valid = false; }
+      }
+    }
+    if (!is_valid) { continue; } // the candidate is pushed again when the triangles around it change
+    // collapse
+    for (unsigned int i_tri: shared) { // remove the dead triangle from the vertices, so `vtx2tri` has only the alive ones
+      if (!tri2alive[i_tri]) { continue; }
+      tri2alive[i_tri] = 0;
+      num_tri_alive -= 1;
+      for (unsigned int i_node = 0; i_node < 3; ++i_node) {
+        auto &tris = vtx2tri[tri2vtx_work(i_node, i_tri)];
+        tris.erase(std::remove(tris.begin(), tris.end(), i_tri), tris.end());
+      }
+    }
+    for (unsigned int i_tri: vtx2tri[c.i_remove]) {
+      if (!tri2alive[i_tri]) { continue; }
+      for (unsigned int i_node = 0; i_node < 3; ++i_node) {
+        if (tri2vtx_work(i_node, i_tri) == c.i_remove) { tri2vtx_work(i_node, i_tri) = c.i_keep; }
+      }
+      vtx2tri[c.i_keep].push_back(i_tri);
+    }
+    vtx2tri[c.i_remove].clear();
+    vtx2xyz_work.col(c.i_keep) = c.xyz;
+    if (is_attr) {
+      vtx2attr_work.col(c.i_keep) = (1.f - c.ratio) * vtx2attr_work.col(c.i_keep) + c.ratio * vtx2attr_work.col(c.i_remove);
+    }
+    vtx2quadric[c.i_keep] += vtx2quadric[c.i_remove];
+    vtx2boundary[c.i_keep] |= vtx2boundary[c.i_remove];
+    vtx2parent[c.i_remove] = c.i_keep;
+    // the triangles around `i_keep` and its neighbors changed: queue all their edges again with new stamps
+    neighbors_of(c.i_keep, neighbors_keep);
+    vtx2stamp[c.i_keep] += 1;
+    vtx2stamp[c.i_remove] += 1;
+    for (unsigned int j_vtx: neighbors_keep) { vtx2stamp[j_vtx] += 1; }
+    for (unsigned int j_vtx: neighbors_keep) {
+      if (const auto c1 = collapse_of(c.i_keep, j_vtx)) { queue.push(*c1); }
+      neighbors_of(j_vtx, neighbors_remove);
+      for (unsigned int k_vtx: neighbors_remove) {
+        if (k_vtx == c.i_keep) { continue; }
+        const bool is_ring = std::binary_search(neighbors_keep.begin(), neighbors_keep.end(), k_vtx);
+        if (is_ring && k_vtx < j_vtx) { continue; } // the edge between two neighbors is queued once
+        if (const auto c1 = collapse_of(j_vtx, k_vtx)) { queue.push(*c1); }
+      }
+    }
+  }
+  // remove the unused vertices keeping the order
+  std::vector<unsigned int> vtx2new(num_vtx, UINT_MAX);
+  for (unsigned int i_tri = 0; i_tri < num_tri; ++i_tri) {
+    if (!tri2alive[i_tri]) { continue; }
+    for (unsigned int i_node = 0; i_node < 3; ++i_node) { vtx2new[tri2vtx_work(i_node, i_tri)] = 0; }
+  }
+  unsigned int num_vtx_new = 0;
+  for (unsigned int &i: vtx2new) { if (i != UINT_MAX) { i = num_vtx_new++; }}
+  MeshLod lod;
+  lod.tri2vtx.resize(3, num_tri_alive);
+  for (unsigned int i_tri = 0, j_tri = 0; i_tri < num_tri; ++i_tri) {
+    if (!tri2alive[i_tri]) { continue; }
+    for (unsigned int i_node = 0; i_node < 3; ++i_node) { lod.tri2vtx(i_node, j_tri) = vtx2new[tri2vtx_work(i_node, i_tri)]; }
+    ++j_tri;
+  }
+  lod.vtx2xyz.resize(3, num_vtx_new);
+  lod.vtx2attr.resize(is_attr ? vtx2attr.rows() : 0, is_attr ? num_vtx_new : 0);
+  for (unsigned int i_vtx = 0; i_vtx < num_vtx; ++i_vtx) {
+    if (vtx2new[i_vtx] == UINT_MAX) { continue; }
+    lod.vtx2xyz.col(vtx2new[i_vtx]) = vtx2xyz_work.col(i_vtx);
+    if (is_attr) { lod.vtx2attr.col(vtx2new[i_vtx]) = vtx2attr_work.col(i_vtx); }
+  }
+  lod.src2vtx.resize(num_vtx);
+  for (unsigned int i_vtx = 0; i_vtx < num_vtx; ++i_vtx) {
+    unsigned int j_vtx = i_vtx;
+    while (vtx2parent[j_vtx] != j_vtx) { j_vtx = vtx2parent[j_vtx]; }
+    vtx2parent[i_vtx] = j_vtx; // shorten the path for the following vertices
+    lod.src2vtx[i_vtx] = vtx2new[j_vtx];
+  }
+  lod.error = deviation_of_simplified_mesh(vtx2xyz, lod.src2vtx, lod.tri2vtx, lod.vtx2xyz);
+  return lod;
+}
+
+/**
+ * chain of the levels of detail, each simplified from the previous level to `ratio` of its triangles,
+ * so building the chain costs about twice the first simplification. The error of each level is measured from
+ * the vertices of the input mesh, following the collapses through the chain (`src2vtx` maps the input vertices).
+ * @param ratio ratio of the numbers of the triangles between the successive levels
+ * @param min_num_tri the chain stops before the level with fewer triangles
+ * @return the levels from the input mesh (level 0) to the coarsest one
+ */
+inline std::vector<MeshLod> lod_chain_of_triangle_mesh(
+    const Eigen::Ref<const Eigen::Matrix<unsigned int, 3, Eigen::Dynamic>> &tri2vtx,
+    const Eigen::Ref<const Eigen::Matrix3Xf> &vtx2xyz,
+    const Eigen::Ref<const Eigen::MatrixXf> &vtx2attr,
+    float ratio = 0.5f,
+    unsigned int min_num_tri = 256) {
+  std::vector<MeshLod> lods(1);
+  lods[0].tri2vtx = tri2vtx;
+  lods[0].vtx2xyz = vtx2xyz;
+  lods[0].vtx2attr = vtx2attr;
+  lods[0].src2vtx.resize(vtx2xyz.cols());
+  for (unsigned int i_vtx = 0; i_vtx < vtx2xyz.cols(); ++i_vtx) { lods[0].src2vtx[i_vtx] = i_vtx; }
+  while (true) {
+    const MeshLod &prev = lods.back();
+    const auto num_tri_prev = static_cast<unsigned int>(prev.tri2vtx.cols());
+    const auto num_tri_target = static_cast<unsigned int>(float(num_tri_prev) * ratio);
+    if (num_tri_target < min_num_tri) { break; }
+    MeshLod lod = simplify_triangle_mesh(prev.tri2vtx, prev.vtx2xyz, prev.vtx2attr, num_tri_target);
+    if (float(lod.tri2vtx.cols()) > float(num_tri_prev) * (1.f + ratio) * 0.5f) { break; } // stuck at the locks
+    std::vector<unsigned int> src2vtx(prev.src2vtx.size()); // from the vertices of the input mesh
+    for (unsigned int i_src = 0; i_src < src2vtx.size(); ++i_src) {
+      const unsigned int i_prev = prev.src2vtx[i_src];
+      src2vtx[i_src] = i_prev == UINT_MAX ? UINT_MAX : lod.src2vtx[i_prev];
+    }
+    lod.src2vtx = std::move(src2vtx);
+    lod.error = deviation_of_simplified_mesh(vtx2xyz, lod.src2vtx, lod.tri2vtx, lod.vtx2xyz);
+    lods.push_back(std::move(lod));
+  }
+  return lods;
+}
+
+/**
+ * pixels spanned by a unit length around a point on the screen
+ * @param transform_xyz2ndc transformation from the coordinates of the mesh to the normalized device coordinates
+ * @param xyz point of the mesh (e.g., the center of its bounding box)
+ * @return pixels per unit length (FLT_MAX if the point is behind the camera)
+ */
+inline float pixels_per_unit_on_screen(
+    const Eigen::Matrix4f &transform_xyz2ndc,
+    const Eigen::Vector3f &xyz,
+    unsigned int width,
+    unsigned int height) {
+  const float w = transform_xyz2ndc.row(3).dot(xyz.homogeneous());
+  if (w <= 0.f) { return FLT_MAX; }
+  const float sx = transform_xyz2ndc.block<1, 3>(0, 0).norm() * 0.5f * float(width);
+  const float sy = transform_xyz2ndc.block<1, 3>(1, 0).norm() * 0.5f * float(height);
+  return std::max(sx, sy) / w;
+}
+
+/**
+ * select the coarsest level whose error is smaller than `max_pixel_error` on the screen
+ * @param pixels_per_unit scale of the mesh on the screen (see `pixels_per_unit_on_screen`)
+ * @return index of the level
+ */
+inline unsigned int select_lod(
+    const std::vector<MeshLod> &lods,
+    float pixels_per_unit,
+    float max_pixel_error = 0.5f) {
+  unsigned int i_lod = 0;
+  while (i_lod + 1 < lods.size() && lods[i_lod + 1].error * pixels_per_unit <= max_pixel_error) { ++i_lod; }
+  return i_lod;
+}
+
+} // namespace acg
+
+#endif //MESH_SIMPLIFY_H_
@@ -0,0 +1,177 @@
+#ifndef MESH_TOPOLOGY_H_
+#define MESH_TOPOLOGY_H_
+
+#include <vector>
+#include <array>
+#include <cstdint>
+#include <climits>
+#include <utility>
+#include <algorithm>
+//
+#include "Eigen/Core"
+#include "util_parallel.h"
+#include "util_triangle_mesh.h"
+
+namespace acg {
+
+/**
+ * sort the keys together with their values by the least-significant-digit radix sort (stable).
+ * The keys are split into chunks, and each pass counts the digits of the chunks and scatters them in parallel.
+ * The passes over the digits that are the same for all the keys (e.g., the upper bits of small keys) are skipped.
+ * @param keys (in/out) keys to sort
+ * @param values (in/out) values moved with the keys
+ * @param num_thread number of threads (0: use all the hardware threads)
+ */
+inline void radix_sort_key_value(
+    std::vector<std::uint64_t> &keys,
+    std::vector<unsigned int> &values,
+    unsigned int num_thread = 0) {
+  constexpr unsigned int num_bit = 8;
+  constexpr unsigned int num_bucket = 1u << num_bit;
+  const size_t num = keys.size();
+  constexpr size_t chunk_size = 1u << 16;
+  const auto num_chunk = static_cast<unsigned int>((num + chunk_size - 1) / chunk_size);
+  std::vector<std::uint64_t> keys_tmp(num);
+  std::vector<unsigned int> values_tmp(num);
+  std::vector<std::array<size_t, num_bucket>> chunk2count(num_chunk);
+  for (unsigned int shift = 0; shift < 64; shift += num_bit) {
+    parallel_for(num_chunk, [&](unsigned int i_chunk) {
+      std::array<size_t, num_bucket> &count = chunk2count[i_chunk];
+      count.fill(0);
+      for (size_t i = i_chunk * chunk_size; i < std::min(num, (i_chunk + 1) * chunk_size); ++i) {
+        count[(keys[i] >> shift) & (num_bucket - 1)] += 1;
+      }
+    }, num_thread);
+    // offsets of the chunks in each bucket: bucket-major, then chunk order for the stability
+    size_t offset = 0;
+    bool is_one_bucket = false;
+    for (unsigned int i_bucket = 0; i_bucket < num_bucket; ++i_bucket) {
+      size_t num_in_bucket = 0;
+      for (unsigned int i_chunk = 0; i_chunk < num_chunk; ++i_chunk) {
+        const size_t n = chunk2count[i_chunk][i_bucket];
+        chunk2count[i_chunk][i_bucket] = offset;
+        offset += n;
+        num_in_bucket += n;
+      }
+      if (num_in_bucket == num) { is_one_bucket = true; }
+    }
+    if (is_one_bucket) { continue; } // this digit does not change the order
+    parallel_for(num_chunk, [&](unsigned int i_chunk) {
+      std::array<size_t, num_bucket> &pos = chunk2count[i_chunk];
+      for (size_t i = i_chunk * chunk_size; i < std::min(num, (i_chunk + 1) * chunk_size); ++i) {
+        const size_t j = pos[(keys[i] >> shift) & (num_bucket - 1)]++;
+        keys_tmp[j] = keys[i];
+        values_tmp[j] = values[i];
+      }
+    }, num_thread);
+    keys.swap(keys_tmp);
+    values.swap(values_tmp);
+  }
+}
+
+/**
+ * Connectivity of a triangle mesh shared by the geometry processing passes.
+ * The half-edge `he` is the `he%3`-th corner of the triangle `he/3` and goes from that corner to the next
+ * corner of the triangle, so the next/previous half-edges need no storage.
+ * The edges are found by sorting the 64-bit keys {smaller vertex, larger vertex} of the half-edges with
+ * the radix sort, and all the queries below are constant time.
+ */
+class MeshTopology {
+ public:
+  using Matrix3Xui = Eigen::Matrix<unsigned int, 3, Eigen::Dynamic>;
+  Matrix3Xui tri2vtx;
+  unsigned int num_vtx = 0;
+  std::vector<unsigned int> vtx2idx; // half-edges from the i-th vertex are idx2he[vtx2idx[i]:vtx2idx[i+1]]
+  std::vector<unsigned int> idx2he; // the triangle of the half-edge `he` is `he/3`
+  std::vector<unsigned int> vtx2jdx; // neighbors of the i-th vertex are jdx2vtx[vtx2jdx[i]:vtx2jdx[i+1]] (sorted)
+  std::vector<unsigned int> jdx2vtx;
+  std::vector<std::array<unsigned int, 2>> edge2vtx; // unique edges {smaller vertex, larger vertex} in sorted order
+  std::vector<unsigned int> he2edge; // edge of the half-edge
+  std::vector<unsigned int> he2opp; // opposite half-edge (UINT_MAX on the boundary or at a non-manifold edge)
+ public:
+  /**
+   * @param num_vtx_ number of the vertices
+   * @param num_thread number of threads (0: use all the hardware threads)
+   */
+  MeshTopology(
+      const Eigen::Ref<const Matrix3Xui> &tri2vtx_,
+      unsigned int num_vtx_,
+      unsigned int num_thread = 0)
+      : tri2vtx(tri2vtx_), num_vtx(num_vtx_) {
+    const auto num_he = static_cast<unsigned int>(tri2vtx.size());
+    std::tie(vtx2idx, idx2he) = vtx2corner_of_triangle_mesh(tri2vtx, num_vtx);
+    // sort the half-edges by their undirected edges
+    std::vector<std::uint64_t> keys(num_he);
+    std::vector<unsigned int> sorted2he(num_he);
+    parallel_for(num_he, [&](unsigned int he) {
+      const unsigned int i0 = source(he), i1 = target(he);
+      keys[he] = (std::uint64_t(std::min(i0, i1)) << 32) | std::max(i0, i1);
+      sorted2he[he] = he;
+    }, num_thread);
+    radix_sort_key_value(keys, sorted2he, num_thread);
+    // runs of the same key are the half-edges of one edge
+    std::vector<unsigned int> sorted2edge(num_he);
+    unsigned int num_edge = 0;
+    for (unsigned int i = 0; i < num_he; ++i) {
+      if (i > 0 && keys[i] != keys[i - 1]) { num_edge += 1; }
+      sorted2edge[i] = num_edge;
+    }
+    if (num_he > 0) { num_edge += 1; }
+    edge2vtx.resize(num_edge);
+    he2edge.resize(num_he);
+    he2opp.assign(num_he, UINT_MAX);
+    parallel_for(num_he, [&](unsigned int i) {
+      const unsigned int he = sorted2he[i];
+      he2edge[he] = sorted2edge[i];
+      const bool is_first = i == 0 || keys[i] != keys[i - 1];
+      if (is_first) { edge2vtx[sorted2edge[i]] = {unsigned(keys[i] >> 32), unsigned(keys[i] & 0xffffffffu)}; }
+      const bool is_last = i + 1 == num_he || keys[i] != keys[i + 1];
+      if (is_first && !is_last && (i + 2 == num_he || keys[i + 2] != keys[i])) { // exactly two half-edges
+        const unsigned int he1 = sorted2he[i + 1];
+        if (source(he) == target(he1)) { // consistently oriented
+          he2opp[he] = he1;
+          he2opp[he1] = he;
+        }
+      }
+    }, num_thread);
+    // the edges sorted by {smaller, larger} give the sorted neighbors: first the smaller, then the larger ones
+    vtx2jdx.assign(num_vtx + 1, 0);
+    for (const auto &e: edge2vtx) {
+      vtx2jdx[e[0] + 1] += 1;
+      vtx2jdx[e[1] + 1] += 1;
+    }
+    for (unsigned int i_vtx = 0; i_vtx < num_vtx; ++i_vtx) { vtx2jdx[i_vtx + 1] += vtx2jdx[i_vtx]; }
+    jdx2vtx.resize(vtx2jdx[num_vtx]);
+    std::vector<unsigned int> vtx2fill(vtx2jdx.begin(), vtx2jdx.end() - 1);
+    for (const auto &e: edge2vtx) {
+      jdx2vtx[vtx2fill[e[1]]++] = e[0];
+    }
+    for (const auto &e: edge2vtx) {
+      jdx2vtx[vtx2fill[e[0]]++] = e[1];
+    }
+  }
+
+  [[nodiscard]] unsigned int num_tri() const { return static_cast<unsigned int>(tri2vtx.cols()); }
+
+  [[nodiscard]] unsigned int num_edge() const { return static_cast<unsigned int>(edge2vtx.size()); }
+
+  [[nodiscard]] unsigned int num_neighbor(unsigned int i_vtx) const { return vtx2jdx[i_vtx + 1] - vtx2jdx[i_vtx]; }
+
+  [[nodiscard]] unsigned int neighbor(unsigned int i_vtx, unsigned int i) const { return jdx2vtx[vtx2jdx[i_vtx] + i]; }
+
+  [[nodiscard]] unsigned int source(unsigned int he) const { return tri2vtx.data()[he]; }
+
+  [[nodiscard]] unsigned int target(unsigned int he) const { return tri2vtx.data()[next(he)]; }
+
+  [[nodiscard]] static unsigned int next(unsigned int he) { return he % 3 == 2 ? he - 2 : he + 1; }
+
+  [[nodiscard]] static unsigned int prev(unsigned int he) { return he % 3 == 0 ? he + 2 : he - 1; }
+
+  [[nodiscard]] unsigned int opposite(unsigned int he) const { return he2opp[he]; }
+
+  [[nodiscard]] bool is_boundary(unsigned int he) const { return he2opp[he] == UINT_MAX; }
+};
+
+} // namespace acg
+
+#endif //MESH_TOPOLOGY_H_
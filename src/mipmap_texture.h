@@ -0,0 +1,218 @@
+#ifndef MIPMAP_TEXTURE_H_
+#define MIPMAP_TEXTURE_H_
+
+#include <vector>
+#include <array>
+#include <cmath>
+#include <utility>
+#include <algorithm>
+//
+#include "util_parallel.h"
+
+namespace acg {
+
+enum class TextureFilter {
+  Nearest, // nearest texel of the finest level
+  Trilinear, // bilinear lookups in the two nearest levels blended by the level of detail
+  Anisotropic, // trilinear lookups along the longer axis of the pixel footprint
+};
+
+/**
+ * Texture with the mip pyramid built once at load. The texture is repeated outside [0,1]^2.
+ * The texels of each level are stored in square tiles of 8x8 texels, and the texels in a tile are in
+ * the Morton (Z-order) order, so the neighbouring texels in both u and v directions are close in the memory.
+ * The four channels of a texel are stored contiguously (RGBA).
+ */
+class MipmapTexture {
+ public:
+  static constexpr unsigned int tile_bits = 3; // a tile has 2^tile_bits x 2^tile_bits texels
+  class Level {
+   public:
+    unsigned int width;
+    unsigned int height;
+    unsigned int num_tile_x;
+    std::vector<unsigned char> texels; // 4 channels per texel in the tiled Morton order
+  };
+  std::vector<Level> levels; // levels[0] is the input image, the size is halved at each level down to 1x1
+ public:
+  /**
+   * build the pyramid by averaging 2x2 texels of the finer level. Along an odd size, a coarse texel averages
+   * three texels weighted by the overlap with its footprint, so the last row or column is not dropped
+   * @param img_data pixel data of the image from top-left to bottom-right
+   * @param num_channel number of channels of the input (1: gray, 2: gray-alpha, 3: RGB, 4: RGBA)
+   */
+  MipmapTexture(
+      unsigned int width,
+      unsigned int height,
+      const std::vector<unsigned char> &img_data,
+      unsigned int num_channel) {
+    if (width == 0 || height == 0) { return; }
+    levels.push_back(allocate_level(width, height));
+    for (unsigned int ih = 0; ih < height; ++ih) {
+      for (unsigned int iw = 0; iw < width; ++iw) {
+        const unsigned char *src = img_data.data() + (ih * width + iw) * num_channel;
+        unsigned char *dst = levels[0].texels.data() + texel_index(levels[0], iw, ih) * 4;
+        dst[0] = src[0];
+        dst[1] = num_channel >= 3 ? src[1] : src[0];
+        dst[2] = num_channel >= 3 ? src[2] : src[0];
+        dst[3] = num_channel == 4 ? src[3] : (num_channel == 2 ? src[1] : 255);
+      }
+    }
+    // fine texels and their weights for the i-th coarse texel along an axis of `num_fine` texels
+    const auto taps = [](unsigned int num_fine, unsigned int num_coarse, unsigned int i) {
+      std::array<std::pair<unsigned int, float>, 3> t = {{{0, 1.f}, {0, 0.f}, {0, 0.f}}}; // one texel
+      if (num_fine > 1 && num_fine % 2 == 0) { t = {{{i * 2, 0.5f}, {i * 2 + 1, 0.5f}, {0, 0.f}}}; }
+      if (num_fine > 1 && num_fine % 2 == 1) { // the footprint covers 2 + 1/num_coarse texels
+        const float w = 1.f / float(num_fine);
+        t = {{{i * 2, float(num_coarse - i) * w}, {i * 2 + 1, float(num_coarse) * w}, {i * 2 + 2, float(i + 1) * w}}};
+      }
+      return t;
+    };
+    while (levels.back().width > 1 || levels.back().height > 1) {
+      const Level &fine = levels.back();
+      Level coarse = allocate_level(std::max(fine.width / 2, 1u), std::max(fine.height / 2, 1u));
+      parallel_for(coarse.height, [&](unsigned int ih) {
+        const auto taps_h = taps(fine.height, coarse.height, ih);
+        for (unsigned int iw = 0; iw < coarse.width; ++iw) {
+          const auto taps_w = taps(fine.width, coarse.width, iw);
+          float sum[4] = {0.f, 0.f, 0.f, 0.f};
+          for (const auto &[jh, wh]: taps_h) {
+            for (const auto &[jw, ww]: taps_w) {
+              if (wh == 0.f || ww == 0.f) { continue; }
+              const unsigned char *t = fine.texels.data() + texel_index(fine, jw, jh) * 4;
+              for (unsigned int i = 0; i < 4; ++i) { sum[i] += wh * ww * float(t[i]); }
+            }
+          }
+          unsigned char *dst = coarse.texels.data() + texel_index(coarse, iw, ih) * 4;
+          for (unsigned int i = 0; i < 4; ++i) {
+            dst[i] = static_cast<unsigned char>(std::min(sum[i] + 0.5f, 255.f));
+          }
+        }
+      });
+      levels.push_back(std::move(coarse));
+    }
+  }
+
+  [[nodiscard]] unsigned int num_level() const { return static_cast<unsigned int>(levels.size()); }
+
+  /**
+   * position of the texel in the storage of the level
+   * @param iw column of the texel from the left
+   * @param ih row of the texel from the top
+   */
+  [[nodiscard]] static unsigned int texel_index(const Level &level, unsigned int iw, unsigned int ih) {
+    constexpr unsigned int mask = (1u << tile_bits) - 1;
+    const unsigned int i_tile = (ih >> tile_bits) * level.num_tile_x + (iw >> tile_bits);
+    return (i_tile << (2 * tile_bits)) + (spread_bits(ih & mask) << 1 | spread_bits(iw & mask));
+  }
+
+  /**
+   * texel of the finest level containing the uv coordinate. This is the same lookup as indexing the image directly.
+   * @param uv texture coordinate. (0,0) is the bottom-left and (1,1) is the top-right of the image
+   */
+  [[nodiscard]] std::array<float, 4> nearest(float u, float v) const {
+    const Level &level = levels[0];
+    const auto iw = std::min(static_cast<unsigned int>((u - std::floor(u)) * float(level.width)), level.width - 1);
+    const auto ih = std::min(static_cast<unsigned int>((1.f - v + std::floor(v)) * float(level.height)), level.height - 1);
+    const unsigned char *t = level.texels.data() + texel_index(level, iw, ih) * 4;
+    return {float(t[0]), float(t[1]), float(t[2]), float(t[3])};
+  }
+
+  /**
+   * bilinear interpolation of the four texels around the uv coordinate in a level
+   */
+  [[nodiscard]] std::array<float, 4> bilinear(unsigned int i_level, float u, float v) const {
+    const Level &level = levels[i_level];
+    const float x = (u - std::floor(u)) * float(level.width) - 0.5f; // texel centers are at integers
+    const float y = (1.f - v + std::floor(v)) * float(level.height) - 0.5f;
+    const float fx = std::floor(x), fy = std::floor(y);
+    const float rx = x - fx, ry = y - fy;
+    const auto wrap = [](float i, unsigned int n) {
+      const int j = static_cast<int>(i) % static_cast<int>(n);
+      return static_cast<unsigned int>(j < 0 ? j + static_cast<int>(n) : j);
+    };
+    const unsigned int iw0 = wrap(fx, level.width), iw1 = wrap(fx + 1.f, level.width);
+    const unsigned int ih0 = wrap(fy, level.height), ih1 = wrap(fy + 1.f, level.height);
+    const unsigned char *t00 = level.texels.data() + texel_index(level, iw0, ih0) * 4;
+    const unsigned char *t10 = level.texels.data() + texel_index(level, iw1, ih0) * 4;
+    const unsigned char *t01 = level.texels.data() + texel_index(level, iw0, ih1) * 4;
+    const unsigned char *t11 = level.texels.data() + texel_index(level, iw1, ih1) * 4;
+    std::array<float, 4> c{};
+    for (unsigned int i = 0; i < 4; ++i) {
+      c[i] = (float(t00[i]) * (1.f - rx) + float(t10[i]) * rx) * (1.f - ry)
+          + (float(t01[i]) * (1.f - rx) + float(t11[i]) * rx) * ry;
+    }
+    return c;
+  }
+
+  /**
+   * blend the bilinear lookups of the two levels around the level of detail
+   * @param lod level of detail. 0 is the finest level and it is clamped to the range of the levels
+   */
+  [[nodiscard]] std::array<float, 4> trilinear(float u, float v, float lod) const {
+    lod = std::clamp(lod, 0.f, float(num_level() - 1));
+    const auto i_level = static_cast<unsigned int>(lod);
+    const float r = lod - float(i_level);
+    const std::array<float, 4> c0 = bilinear(i_level, u, v);
+    if (r == 0.f || i_level + 1 >= num_level()) { return c0; }
+    const std::array<float, 4> c1 = bilinear(i_level + 1, u, v);
+    return {
+        c0[0] + (c1[0] - c0[0]) * r, c0[1] + (c1[1] - c0[1]) * r,
+        c0[2] + (c1[2] - c0[2]) * r, c0[3] + (c1[3] - c0[3]) * r};
+  }
+
+  /**
+   * sample the texture with the footprint of a pixel given by the screen-space derivatives of the uv coordinate
+   * @param dudx change of u when moving one pixel to the right (dvdx, dudy, dvdy likewise, y is downward)
+   * @param max_anisotropy maximum number of trilinear lookups along the longer axis of the footprint
+   */
+  [[nodiscard]] std::array<float, 4> sample(
+      float u, float v,
+      float dudx, float dvdx, float dudy, float dvdy,
+      TextureFilter filter,
+      unsigned int max_anisotropy = 8) const {
+    if (filter == TextureFilter::Nearest) { return nearest(u, v); }
+    // axes of the footprint measured in the texels of the finest level
+    const float w = float(levels[0].width), h = float(levels[0].height);
+    const float len_x = std::sqrt(dudx * dudx * w * w + dvdx * dvdx * h * h);
+    const float len_y = std::sqrt(dudy * dudy * w * w + dvdy * dvdy * h * h);
+    const float len_max = std::max(len_x, len_y), len_min = std::min(len_x, len_y);
+    if (filter == TextureFilter::Trilinear || len_min <= 0.f || max_anisotropy <= 1) {
+      return trilinear(u, v, std::log2(std::max(len_max, 1.0e-8f)));
+    }
+    // the footprint is covered by several lookups whose level is chosen by the shorter axis
+    const auto num_sample = static_cast<unsigned int>(
+        std::min(std::ceil(len_max / len_min), float(max_anisotropy)));
+    const float lod = std::log2(len_max / float(num_sample));
+    const float du = len_x >= len_y ? dudx : dudy;
+    const float dv = len_x >= len_y ? dvdx : dvdy;
+    std::array<float, 4> c{0.f, 0.f, 0.f, 0.f};
+    for (unsigned int i_sample = 0; i_sample < num_sample; ++i_sample) {
+      const float t = (float(i_sample) + 0.5f) / float(num_sample) - 0.5f;
+      const std::array<float, 4> ci = trilinear(u + du * t, v + dv * t, lod);
+      for (unsigned int i = 0; i < 4; ++i) { c[i] += ci[i] / float(num_sample); }
+    }
+    return c;
+  }
+
+ private:
+  static Level allocate_level(unsigned int width, unsigned int height) {
+    const unsigned int num_tile_x = (width + (1u << tile_bits) - 1) >> tile_bits;
+    const unsigned int num_tile_y = (height + (1u << tile_bits) - 1) >> tile_bits;
+    return Level{width, height, num_tile_x,
+                 std::vector<unsigned char>(num_tile_x * num_tile_y * (1u << (2 * tile_bits)) * 4, 0)};
+  }
+
+  /**
+   * insert a zero bit above each of the lower bits: 0b111 -> 0b10101
+   */
+  static unsigned int spread_bits(unsigned int i) {
+    i = (i | (i << 2)) & 0x33u;
+    i = (i | (i << 1)) & 0x55u;
+    return i;
+  }
+};
+
+} // namespace acg
+
+#endif //MIPMAP_TEXTURE_H_
@@ -12,8 +12,13 @@
 #include <optional>
 #include <map>
 #include <iostream>
+#include <string_view>
+#include <charconv>
+#include <cctype>
+#include <filesystem>
 //
 #include "Eigen/Dense"
+#include "mapped_file.h"
 
 namespace acg {
 
@@ -337,6 +342,214 @@ std::vector<std::vector<Edge>> svg_loops_from_outline_path(
   return loops;
 }
 
+/**
+ * Outline of all the `<path>` elements in an SVG file.
+ * The edges of all the loops are stored contiguously in one array.
+ */
+class SvgOutline {
+ public:
+  unsigned int width = 0;
+  unsigned int height = 0;
+  std::vector<Edge> edges;
+  std::vector<unsigned int> loop2idx = {0}; // edges of the i-th loop are edges[loop2idx[i]:loop2idx[i+1]]
+ public:
+  [[nodiscard]] unsigned int num_loop() const { return static_cast<unsigned int>(loop2idx.size() - 1); }
+
+  /**
+   * @return copy of the edges grouped by the loops
+   */
+  [[nodiscard]] std::vector<std::vector<Edge>> loops() const {
+    std::vector<std::vector<Edge>> loops(num_loop());
+    for (unsigned int i_loop = 0; i_loop < num_loop(); ++i_loop) {
+      loops[i_loop].assign(edges.begin() + loop2idx[i_loop], edges.begin() + loop2idx[i_loop + 1]);
+    }
+    return loops;
+  }
+};
+
+/**
+ * value of an attribute in the contents of a tag, e.g., `path id="a" d="M 0,0 ..."`
+ * @param tag contents of a tag between `<` and `>`
+ * @param name name of the attribute
+ * @return value without the quotes (empty if the attribute is not found)
+ */
+std::string_view svg_attribute(
+    std::string_view tag,
+    std::string_view name) {
+  const auto is_space = [](char c) { return c == ' ' || c == '\t' || c == '\n' || c == '\r'; };
+  size_t pos = 0;
+  while (pos < tag.size() && !is_space(tag[pos])) { ++pos; } // skip the tag name
+  while (pos < tag.size()) {
+    while (pos < tag.size() && is_space(tag[pos])) { ++pos; }
+    const size_t name_start = pos;
+    while (pos < tag.size() && tag[pos] != '=' && !is_space(tag[pos])) { ++pos; }
+    const std::string_view attr_name = tag.substr(name_start, pos - name_start);
+    while (pos < tag.size() && is_space(tag[pos])) { ++pos; }
+    if (pos >= tag.size() || tag[pos] != '=') { continue; } // attribute without value
+    ++pos;
+    while (pos < tag.size() && is_space(tag[pos])) { ++pos; }
+    if (pos >= tag.size() || (tag[pos] != '"' && tag[pos] != '\'')) { return {}; }
+    const size_t value_end = tag.find(tag[pos], pos + 1);
+    if (value_end == std::string_view::npos) { return {}; }
+    if (attr_name == name) { return tag.substr(pos + 1, value_end - pos - 1); }
+    pos = value_end + 1;
+  }
+  return {};
+}
+
+/**
+ * parse the path data (the `d` attribute) and append the edges and loops to the outline.
+ * The commands M/m, L/l, H/h, V/v, Q/q and Z/z are supported, including the repeated arguments
+ * without the command letter. An open sub-path is closed as it is filled.
+ * @param d path data
+ * @param[in,out] outline edges and loops are appended. It is left unchanged if the path data has an error,
+ * so every consumer sees only the closed loops of the valid paths
+ * @return false if the path data has an error
+ */
+bool svg_append_path_edges(
+    std::string_view d,
+    SvgOutline &outline) {
+  const char *const end = d.data() + d.size();
+  const char *s = d.data();
+  const auto skip_separator = [&]() {
+    while (s < end && (*s == ' ' || *s == ',' || *s == '\t' || *s == '\n' || *s == '\r')) { ++s; }
+  };
+  const auto read_numbers = [&](float *values, unsigned int num) {
+    for (unsigned int i = 0; i < num; ++i) {
+      skip_separator();
+      if (s < end && *s == '+') { ++s; } // from_chars does not accept the plus sign
+      const auto[ptr, ec] = std::from_chars(s, end, values[i]);
+      if (ec != std::errc()) { return false; }
+      s = ptr;
+    }
+    return true;
+  };
+  std::vector<Edge> &edges = outline.edges;
+  const size_t num_edge_start = edges.size();
+  const size_t num_loop_start = outline.loop2idx.size();
+  const auto discard_path = [&]() { // remove the edges and the loops of this path appended so far
+    edges.erase(edges.begin() + static_cast<std::ptrdiff_t>(num_edge_start), edges.end());
+    outline.loop2idx.resize(num_loop_start);
+    return false;
+  };
+  Eigen::Vector2f pos_cur(0., 0.);
+  Eigen::Vector2f pos_start(0., 0.); // start of the current sub-path
+  const auto close_loop = [&]() {
+    if (edges.size() > outline.loop2idx.back()) {
+      if ((pos_cur - pos_start).norm() > 1.0e-9) { edges.emplace_back(pos_cur, pos_start); }
+      outline.loop2idx.push_back(static_cast<unsigned int>(edges.size()));
+    }
+    pos_cur = pos_start;
+  };
+  char cmd = 0;
+  for (;;) {
+    skip_separator();
+    if (s == end) { break; }
+    if (std::isalpha(static_cast<unsigned char>(*s))) {
+      cmd = *s++;
+      if (cmd == 'Z' || cmd == 'z') {
+        close_loop();
+        cmd = 0; // a number cannot follow
+        continue;
+      }
+    } else if (cmd == 0) {
+      std::cout << "error!--> number without a command in the path" << std::endl;
+      return discard_path();
+    }
+    float v[4];
+    const bool is_relative = std::islower(static_cast<unsigned char>(cmd));
+    const Eigen::Vector2f org = is_relative ? pos_cur : Eigen::Vector2f(0., 0.);
+    bool is_ok = true;
+    switch (cmd) {
+      case 'M':
+      case 'm':
+        if (!(is_ok = read_numbers(v, 2))) { break; }
+        close_loop();
+        pos_cur = pos_start = org + Eigen::Vector2f(v[0], v[1]);
+        cmd = is_relative ? 'l' : 'L'; // the following pairs are the line-to
+        break;
+      case 'L':
+      case 'l':
+        if (!(is_ok = read_numbers(v, 2))) { break; }
+        edges.emplace_back(pos_cur, org + Eigen::Vector2f(v[0], v[1]));
+        pos_cur = edges.back().pe;
+        break;
+      case 'H':
+      case 'h':
+        if (!(is_ok = read_numbers(v, 1))) { break; }
+        edges.emplace_back(pos_cur, Eigen::Vector2f(org.x() + v[0], pos_cur.y()));
+        pos_cur = edges.back().pe;
+        break;
+      case 'V':
+      case 'v':
+        if (!(is_ok = read_numbers(v, 1))) { break; }
+        edges.emplace_back(pos_cur, Eigen::Vector2f(pos_cur.x(), org.y() + v[0]));
+        pos_cur = edges.back().pe;
+        break;
+      case 'Q':
+      case 'q':
+        if (!(is_ok = read_numbers(v, 4))) { break; }
+        edges.emplace_back(pos_cur, org + Eigen::Vector2f(v[0], v[1]), org + Eigen::Vector2f(v[2], v[3]));
+        pos_cur = edges.back().pe;
+        break;
+      default:
+        std::cout << "error!--> unsupported command " << cmd << std::endl;
+        return discard_path();
+    }
+    if (!is_ok) {
+      std::cout << "error!--> wrong number in the path" << std::endl;
+      return discard_path();
+    }
+  }
+  close_loop();
+  return true;
+}
+
+/**
+ * read the size of the image and the outline of all the `<path>` elements in an SVG file.
+ * The file is memory-mapped and parsed in a single pass without copying the contents.
+ * A path with an error (e.g., an unsupported command) is skipped as a whole and reported.
+ * @param file_path path to the SVG file
+ * @return outline, or std::nullopt if the file cannot be opened
+ */
+std::optional<SvgOutline> svg_read_outline(const std::filesystem::path &file_path) {
+  const MappedFile file(file_path);
+  if (!file.is_open()) { return std::nullopt; }
+  const std::string_view str = file.view();
+  SvgOutline outline;
+  const auto is_tag = [](std::string_view tag, std::string_view name) {
+    return tag.size() > name.size() && tag.compare(0, name.size(), name) == 0
+        && std::isspace(static_cast<unsigned char>(tag[name.size()]));
+  };
+  for (size_t pos = str.find('<'); pos != std::string_view::npos; pos = str.find('<', pos)) {
+    size_t pos_end = pos + 1; // find the closing '>' outside the quotes
+    for (char quote = 0; pos_end < str.size(); ++pos_end) {
+      const char c = str[pos_end];
+      if (quote != 0) {
+        if (c == quote) { quote = 0; }
+      } else if (c == '"' || c == '\'') {
+        quote = c;
+      } else if (c == '>') {
+        break;
+      }
+    }
+    if (pos_end >= str.size()) { break; }
+    const std::string_view tag = str.substr(pos + 1, pos_end - pos - 1);
+    pos = pos_end + 1;
+    if (is_tag(tag, "svg")) {
+      const std::string_view w = svg_attribute(tag, "width");
+      const std::string_view h = svg_attribute(tag, "height");
+      std::from_chars(w.data(), w.data() + w.size(), outline.width);
+      std::from_chars(h.data(), h.data() + h.size(), outline.height);
+    } else if (is_tag(tag, "path")) {
+      if (!svg_append_path_edges(svg_attribute(tag, "d"), outline)) {
+        std::cout << "error!--> the path is skipped" << std::endl;
+      }
+    }
+  }
+  return outline;
+}
+
 } // acg
 
 #endif //PARSE_SVG_H_
@@ -0,0 +1,172 @@
+#ifndef RASTERIZE_COVERAGE_H_
+#define RASTERIZE_COVERAGE_H_
+
+#include <vector>
+#include <array>
+#include <cmath>
+#include <algorithm>
+//
+#include "Eigen/Core"
+#include "parse_svg.h"
+
+namespace acg {
+
+/**
+ * Rasterizer computing the exact fractional area of each pixel covered by a shape bounded by line segments.
+ * Each segment accumulates the signed area it sweeps in the cells it crosses (as in the font rasterizers),
+ * and the prefix sum along each row gives the coverage. The area is exact for the segments and
+ * a quadratic Bézier curve is flattened into segments within the tolerance.
+ */
+class CoverageRasterizer {
+ public:
+  unsigned int width;
+  unsigned int height;
+  std::vector<float> accumulation; // signed area, (width + 2) cells per row
+ public:
+  CoverageRasterizer(unsigned int width_, unsigned int height_)
+      : width(width_), height(height_), accumulation((width_ + 2) * height_, 0.f) {}
+
+  /**
+   * accumulate the signed area swept by a line segment.
+   * The segment is split where it crosses the left and the right sides of the image, so that each piece lies
+   * on one side of them: the pieces on the left accumulate their whole area at the left-most cell, and
+   * the pieces on the right are accumulated in the cell out of the image, which is never summed.
+   * @param p0 start point in the pixel coordinate
+   * @param p1 end point in the pixel coordinate
+   */
+  void add_line(
+      const Eigen::Vector2f &p0,
+      const Eigen::Vector2f &p1) {
+    if (p0.y() == p1.y()) { return; }
+    std::array<float, 4> ts = {0.f, 1.f, 1.f, 1.f}; // parameters of the split points on the segment
+    unsigned int num_t = 1;
+    for (const float x: {0.f, float(width)}) {
+      if ((p0.x() < x) == (p1.x() < x)) { continue; } // not crossing
+      ts[num_t++] = (x - p0.x()) / (p1.x() - p0.x());
+    }
+    ts[num_t] = 1.f;
+    std::sort(ts.begin(), ts.begin() + num_t + 1);
+    for (unsigned int i = 0; i < num_t; ++i) {
+      const Eigen::Vector2f q0 = i == 0 ? p0 : Eigen::Vector2f(p0 + (p1 - p0) * ts[i]);
+      const Eigen::Vector2f q1 = i + 1 == num_t ? p1 : Eigen::Vector2f(p0 + (p1 - p0) * ts[i + 1]);
+      add_line_piece(q0, q1);
+    }
+  }
+
+  /**
+   * accumulate the quadratic Bézier curve flattened into line segments
+   * @param ps start point
+   * @param pc control point
+   * @param pe end point
+   * @param tolerance maximum distance between the curve and the segments in pixel
+   */
+  void add_quadratic_bezier(
+      const Eigen::Vector2f &ps,
+      const Eigen::Vector2f &pc,
+      const Eigen::Vector2f &pe,
+      float tolerance = 0.05f) {
+    // the deviation of the curve from the chord is bounded by |ps - 2pc + pe| / 4 / num_segment^2
+    const float deviation = (ps - 2.f * pc + pe).norm() * 0.25f;
+    const auto num_segment = static_cast<unsigned int>(std::max(1.f, std::ceil(std::sqrt(deviation / tolerance))));
+    Eigen::Vector2f p0 = ps;
+    for (unsigned int i_segment = 1; i_segment <= num_segment; ++i_segment) {
+      const float t = float(i_segment) / float(num_segment);
+      const Eigen::Vector2f p1 = (1.f - t) * (1.f - t) * ps + 2.f * t * (1.f - t) * pc + t * t * pe;
+      add_line(p0, p1);
+      p0 = p1;
+    }
+  }
+
+  /**
+   * accumulate all the edges
+   * @param edges line segments and quadratic Bézier curves of closed loops
+   */
+  void add_edges(const std::vector<Edge> &edges) {
+    for (const auto &edge: edges) {
+      if (edge.is_bezier) {
+        add_quadratic_bezier(edge.ps, edge.pc, edge.pe);
+      } else {
+        add_line(edge.ps, edge.pe);
+      }
+    }
+  }
+
+  /**
+   * coverage of the pixels by the prefix sum of the accumulated area
+   * @param is_even_odd use even-odd fill rule if true, otherwise use non-zero fill rule
+   * @return coverage in [0,1] of each pixel
+   */
+  [[nodiscard]] std::vector<float> coverage(bool is_even_odd) const {
+    std::vector<float> pix2coverage(width * height, 0.f);
+    for (unsigned int ih = 0; ih < height; ++ih) {
+      float sum = 0.f;
+      for (unsigned int iw = 0; iw < width; ++iw) {
+        sum += accumulation[ih * (width + 2) + iw];
+        float c = std::fabs(sum);
+        if (is_even_odd) { // fold the winding number as 0 -> 1 -> 0 -> 1...
+          c = std::fmod(c, 2.f);
+          c = c > 1.f ? 2.f - c : c;
+        }
+        pix2coverage[ih * width + iw] = std::min(c, 1.f);
+      }
+    }
+    return pix2coverage;
+  }
+
+ private:
+  /**
+   * accumulate the signed area swept by a line segment not crossing the left and the right sides of the image
+   */
+  void add_line_piece(
+      const Eigen::Vector2f &p0,
+      const Eigen::Vector2f &p1) {
+    if (p0.y() == p1.y()) { return; }
+    const float dir = p0.y() < p1.y() ? 1.f : -1.f;
+    const Eigen::Vector2f &pa = p0.y() < p1.y() ? p0 : p1; // upper point
+    const Eigen::Vector2f &pb = p0.y() < p1.y() ? p1 : p0; // lower point
+    const float dxdy = (pb.x() - pa.x()) / (pb.y() - pa.y());
+    const float xmax = float(width); // the clamp only moves the piece along the side it lies on
+    const auto ih_start = static_cast<unsigned int>(std::max(0.f, pa.y()));
+    const auto ih_end = static_cast<unsigned int>(std::clamp(std::ceil(pb.y()), 0.f, float(height)));
+    for (unsigned int ih = ih_start; ih < ih_end; ++ih) {
+      float *acc = accumulation.data() + ih * (width + 2);
+      const float y_top = std::max(float(ih), pa.y());
+      const float y_bottom = std::min(float(ih + 1), pb.y());
+      const float d = (y_bottom - y_top) * dir; // signed height of the segment in this row
+      const float xa = std::clamp(pa.x() + (y_top - pa.y()) * dxdy, 0.f, xmax);
+      const float xb = std::clamp(pa.x() + (y_bottom - pa.y()) * dxdy, 0.f, xmax);
+      const float x0 = std::min(xa, xb);
+      const float x1 = std::max(xa, xb);
+      const float x0floor = std::floor(x0);
+      const auto x0i = static_cast<unsigned int>(x0floor);
+      const float x1ceil = std::ceil(x1);
+      const auto x1i = static_cast<unsigned int>(x1ceil);
+      if (x1i <= x0i + 1) { // the segment is in a single cell
+        const float xmf = 0.5f * (xa + xb) - x0floor; // the area on the right of the segment in the cell
+        acc[x0i] += d - d * xmf;
+        acc[x0i + 1] += d * xmf;
+      } else { // the segment crosses several cells
+        const float s = 1.f / (x1 - x0);
+        const float x0f = x0 - x0floor;
+        const float a0 = 0.5f * s * (1.f - x0f) * (1.f - x0f);
+        const float x1f = x1 - x1ceil + 1.f;
+        const float am = 0.5f * s * x1f * x1f;
+        acc[x0i] += d * a0;
+        if (x1i == x0i + 2) {
+          acc[x0i + 1] += d * (1.f - a0 - am);
+        } else {
+          const float a1 = s * (1.5f - x0f);
+          acc[x0i + 1] += d * (a1 - a0);
+          for (unsigned int iw = x0i + 2; iw < x1i - 1; ++iw) { acc[iw] += d * s; }
+          const float a2 = a1 + float(x1i - x0i - 3) * s;
+          acc[x1i - 1] += d * (1.f - a2 - am);
+        }
+        acc[x1i] += d * am;
+      }
+    }
+  }
+};
+
+} // namespace acg
+
+#endif //RASTERIZE_COVERAGE_H_
@@ -0,0 +1,334 @@
+#ifndef RASTERIZE_LINE_H_
+#define RASTERIZE_LINE_H_
+
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include <climits>
+#include <algorithm>
+//
+#include "util_parallel.h"
+
+namespace acg {
+
+/**
+ * clip a segment to an axis-aligned rectangle (Liang–Barsky algorithm)
+ * @param[out] t0 parameter of the segment `(x0,y0) + t * (x1-x0,y1-y0)` where it enters the rectangle
+ * @param[out] t1 parameter where it leaves the rectangle
+ * @return false if the segment is completely outside
+ */
+bool clip_segment_liang_barsky(
+    float x0, float y0,
+    float x1, float y1,
+    float xmin, float ymin,
+    float xmax, float ymax,
+    float &t0, float &t1) {
+  const float p[4] = {x0 - x1, x1 - x0, y0 - y1, y1 - y0};
+  const float q[4] = {x0 - xmin, xmax - x0, y0 - ymin, ymax - y0};
+  t0 = 0.f;
+  t1 = 1.f;
+  for (unsigned int i = 0; i < 4; ++i) {
+    if (p[i] == 0.f) { // parallel to this boundary
+      if (q[i] < 0.f) { return false; }
+      continue;
+    }
+    const float r = q[i] / p[i];
+    if (p[i] < 0.f) {
+      t0 = std::max(t0, r);
+    } else {
+      t1 = std::min(t1, r);
+    }
+  }
+  return t0 <= t1;
+}
+
+/**
+ * Integer-only Bresenham line between two pixels.
+ * The pixel at any step is computed directly, so a part of the line can be drawn from any step
+ * and the pixels are exactly the same as walking the whole line.
+ */
+class BresenhamLine {
+ public:
+  int x0, y0; // first pixel
+  int sx, sy; // direction of the step (+1 or -1)
+  int64_t major, minor; // absolute differences along the major and minor axes
+  bool is_x_major;
+ public:
+  BresenhamLine(int x0_, int y0_, int x1, int y1)
+      : x0(x0_), y0(y0_), sx(x1 >= x0_ ? 1 : -1), sy(y1 >= y0_ ? 1 : -1) {
+    const int64_t adx = std::abs(int64_t(x1) - x0_);
+    const int64_t ady = std::abs(int64_t(y1) - y0_);
+    is_x_major = adx >= ady;
+    major = is_x_major ? adx : ady;
+    minor = is_x_major ? ady : adx;
+  }
+
+  /**
+   * @return number of the steps (the line has `num_step() + 1` pixels)
+   */
+  [[nodiscard]] unsigned int num_step() const { return static_cast<unsigned int>(major); }
+
+  /**
+   * call `func(x, y)` for the pixels from the `k_begin`-th to the `k_end`-th step (inclusive)
+   */
+  template<typename FUNC>
+  void for_each_pixel(unsigned int k_begin, unsigned int k_end, FUNC &&func) const {
+    if (major == 0) {
+      if (k_begin == 0) { func(x0, y0); }
+      return;
+    }
+    // the minor coordinate at step k is floor((2 k minor + major) / (2 major)), i.e., rounded
+    const int64_t num = 2 * int64_t(k_begin) * minor + major;
+    int64_t m = num / (2 * major); // minor offset
+    int64_t err = num % (2 * major); // remainder
+    for (int64_t k = k_begin; k <= k_end; ++k) {
+      const int64_t a = is_x_major ? k : m;
+      const int64_t b = is_x_major ? m : k;
+      func(static_cast<int>(x0 + sx * a), static_cast<int>(y0 + sy * b));
+      err += 2 * minor;
+      if (err >= 2 * major) {
+        err -= 2 * major;
+        ++m;
+      }
+    }
+  }
+};
+
+/**
+ * draw a line between two pixels by the Bresenham algorithm. Only the steps inside the image are walked.
+ * @param row_begin first row to draw (the rows outside [row_begin, row_end) are not touched)
+ * @param row_end end of the rows to draw
+ */
+void draw_line_bresenham(
+    int x0, int y0,
+    int x1, int y1,
+    std::vector<unsigned char> &img_data,
+    unsigned int width,
+    unsigned int height,
+    unsigned char brightness,
+    unsigned int row_begin = 0,
+    unsigned int row_end = UINT_MAX) {
+  row_end = std::min(row_end, height);
+  if (row_begin >= row_end) { return; }
+  float t0, t1;
+  if (!clip_segment_liang_barsky(
+      float(x0), float(y0), float(x1), float(y1),
+      -0.5f, float(row_begin) - 0.5f, float(width) - 0.5f, float(row_end) - 0.5f, t0, t1)) { return; }
+  const BresenhamLine line(x0, y0, x1, y1);
+  const float n = float(line.num_step());
+  // one extra step on both sides for the rounding, the pixels are tested anyway
+  const auto k_begin = static_cast<unsigned int>(std::max(0.f, std::floor(t0 * n) - 1.f));
+  const auto k_end = static_cast<unsigned int>(std::min(n, std::ceil(t1 * n) + 1.f));
+  line.for_each_pixel(k_begin, k_end, [&](int x, int y) {
+    if (x < 0 || x >= int(width) || y < int(row_begin) || y >= int(row_end)) { return; }
+    img_data[y * width + x] = brightness;
+  });
+}
+
+/**
+ * draw a line with the Bresenham algorithm from the pixel coordinates (pixel center is at +0.5)
+ */
+void draw_line(
+    float x0, float y0,
+    float x1, float y1,
+    std::vector<unsigned char> &img_data,
+    unsigned int width,
+    unsigned int height,
+    unsigned char brightness,
+    unsigned int row_begin = 0,
+    unsigned int row_end = UINT_MAX) {
+  float t0, t1; // clip to the guard band first so the end points fit in the integer
+  if (!clip_segment_liang_barsky(
+      x0, y0, x1, y1, -1.f, -1.f, float(width) + 1.f, float(height) + 1.f, t0, t1)) { return; }
+  const float dx = x1 - x0, dy = y1 - y0;
+  draw_line_bresenham(
+      int(std::floor(x0 + t0 * dx)), int(std::floor(y0 + t0 * dy)),
+      int(std::floor(x0 + t1 * dx)), int(std::floor(y0 + t1 * dy)),
+      img_data, width, height, brightness, row_begin, row_end);
+}
+
+/**
+ * draw an anti-aliased line (Xiaolin Wu's algorithm). The pixels are blended toward the brightness
+ * by the coverage distributed to the two pixels nearest to the line at each step.
+ * The coverage at each step is computed from the original end points, so a clipped part of the line
+ * is identical to the same part of the whole line.
+ * @param x0 x-coordinate of the first end point (pixel center is at +0.5)
+ */
+void draw_line_wu(
+    float x0, float y0,
+    float x1, float y1,
+    std::vector<unsigned char> &img_data,
+    unsigned int width,
+    unsigned int height,
+    unsigned char brightness,
+    unsigned int row_begin = 0,
+    unsigned int row_end = UINT_MAX) {
+  row_end = std::min(row_end, height);
+  if (row_begin >= row_end) { return; }
+  const bool is_steep = std::fabs(y1 - y0) > std::fabs(x1 - x0);
+  // work in the coordinate where the pixel center is at the integer and the major axis is the first
+  float a0 = (is_steep ? y0 : x0) - 0.5f, b0 = (is_steep ? x0 : y0) - 0.5f;
+  float a1 = (is_steep ? y1 : x1) - 0.5f, b1 = (is_steep ? x1 : y1) - 0.5f;
+  if (a0 > a1) {
+    std::swap(a0, a1);
+    std::swap(b0, b1);
+  }
+  const float gradient = a1 > a0 ? (b1 - b0) / (a1 - a0) : 0.f;
+  // the box is widened by one step: the end columns `lround(a0)` and `lround(a1)` extend the line
+  // by up to half a step beyond the end points, which moves it by less than one pixel on both axes
+  const float amin = (is_steep ? float(row_begin) : 0.f) - 2.f;
+  const float amax = float(is_steep ? row_end : width) + 1.f;
+  const float bmin = (is_steep ? 0.f : float(row_begin)) - 2.f;
+  const float bmax = float(is_steep ? width : row_end) + 1.f;
+  float t0, t1; // skip the steps outside the image
+  if (!clip_segment_liang_barsky(a0, b0, a1, b1, amin, bmin, amax, bmax, t0, t1)) { return; }
+  const int ia_begin = std::max(int(std::lround(a0)), int(std::floor(a0 + t0 * (a1 - a0))));
+  const int ia_end = std::min(int(std::lround(a1)), int(std::ceil(a0 + t1 * (a1 - a0))));
+  const auto plot = [&](int ia, int ib, float coverage) {
+    const int x = is_steep ? ib : ia;
+    const int y = is_steep ? ia : ib;
+    if (x < 0 || x >= int(width) || y < int(row_begin) || y >= int(row_end) || coverage <= 0.f) { return; }
+    unsigned char &c = img_data[y * width + x];
+    c = static_cast<unsigned char>(std::lround(float(c) + (float(brightness) - float(c)) * std::min(coverage, 1.f)));
+  };
+  for (int ia = ia_begin; ia <= ia_end; ++ia) {
+    // length of the line within the column [ia-0.5, ia+0.5] along the major axis
+    const float cover_major = std::min(float(ia) + 0.5f, a1) - std::max(float(ia) - 0.5f, a0);
+    if (a1 == a0) { // a dot
+      plot(ia, int(std::lround(b0)), 1.f);
+      continue;
+    }
+    const float b = b0 + (float(ia) - a0) * gradient;
+    const float bf = std::floor(b);
+    const float frac = b - bf;
+    plot(ia, int(bf), (1.f - frac) * cover_major);
+    plot(ia, int(bf) + 1, frac * cover_major);
+  }
+}
+
+/**
+ * draw a thick line as the rectangle around the segment. The pixels whose centers are inside are painted.
+ * @param thickness width of the line in pixel
+ */
+void draw_thick_line(
+    float x0, float y0,
+    float x1, float y1,
+    float thickness,
+    std::vector<unsigned char> &img_data,
+    unsigned int width,
+    unsigned int height,
+    unsigned char brightness,
+    unsigned int row_begin = 0,
+    unsigned int row_end = UINT_MAX) {
+  row_end = std::min(row_end, height);
+  const float length = std::sqrt((x1 - x0) * (x1 - x0) + (y1 - y0) * (y1 - y0));
+  if (length == 0.f || row_begin >= row_end) { return; }
+  const float tx = (x1 - x0) / length, ty = (y1 - y0) / length; // tangent
+  const float nx = -ty, ny = tx; // normal
+  const float half = 0.5f * thickness;
+  const float ymin = std::min(y0, y1) - half;
+  const float ymax = std::max(y0, y1) + half;
+  const auto ih_begin = static_cast<unsigned int>(std::clamp(std::floor(ymin), float(row_begin), float(row_end)));
+  const auto ih_end = static_cast<unsigned int>(std::clamp(std::ceil(ymax), float(row_begin), float(row_end)));
+  for (unsigned int ih = ih_begin; ih < ih_end; ++ih) {
+    const float y = float(ih) + 0.5f;
+    float xl = -1.f, xr = float(width) + 1.f;
+    // keep the range of x where `a * x + b` is in [lo, hi]
+    const auto restrict = [&](float a, float b, float lo, float hi) {
+      if (std::fabs(a) < 1.0e-6f) {
+        if (b < lo || b > hi) { xr = xl - 1.f; }
+        return;
+      }
+      const float xa = (lo - b) / a, xb = (hi - b) / a;
+      xl = std::max(xl, std::min(xa, xb));
+      xr = std::min(xr, std::max(xa, xb));
+    };
+    restrict(nx, ny * (y - y0) - nx * x0, -half, half); // distance from the line
+    restrict(tx, ty * (y - y0) - tx * x0, 0.f, length); // between the end points
+    const float iw_begin = std::max(0.f, std::ceil(xl - 0.5f));
+    const float iw_end = std::min(float(width) - 1.f, std::floor(xr - 0.5f));
+    for (float iw = iw_begin; iw <= iw_end; iw += 1.f) {
+      img_data[ih * width + static_cast<unsigned int>(iw)] = brightness;
+    }
+  }
+}
+
+enum class LineStyle {
+  Bresenham,
+  Wu,
+  Thick
+};
+
+/**
+ * draw many segments in parallel. The image is split into horizontal bands, each segment is
+ * registered to the bands its bounding box overlaps, and each band is drawn by a thread.
+ * The pixels are the same as drawing the segments one by one in the order.
+ * @param seg2xy end points of the segments (x0,y0,x1,y1 for each segment)
+ * @param style style of the lines
+ * @param thickness width of the line for `LineStyle::Thick`
+ * @param num_thread number of threads (0: use all the hardware threads)
+ * @param band_height number of rows of a band
+ */
+void draw_lines(
+    const std::vector<float> &seg2xy,
+    LineStyle style,
+    float thickness,
+    std::vector<unsigned char> &img_data,
+    unsigned int width,
+    unsigned int height,
+    unsigned char brightness,
+    unsigned int num_thread = 0,
+    unsigned int band_height = 32) {
+  const auto num_seg = static_cast<unsigned int>(seg2xy.size() / 4);
+  const auto draw_segment = [&](unsigned int i_seg, unsigned int row_begin, unsigned int row_end) {
+    const float *p = seg2xy.data() + i_seg * 4;
+    if (style == LineStyle::Bresenham) {
+      draw_line(p[0], p[1], p[2], p[3], img_data, width, height, brightness, row_begin, row_end);
+    } else if (style == LineStyle::Wu) {
+      draw_line_wu(p[0], p[1], p[2], p[3], img_data, width, height, brightness, row_begin, row_end);
+    } else {
+      draw_thick_line(p[0], p[1], p[2], p[3], thickness, img_data, width, height, brightness, row_begin, row_end);
+    }
+  };
+  if (num_thread == 0) { num_thread = num_default_threads(); }
+  if (num_thread == 1) { // the bands would only add the overhead
+    for (unsigned int i_seg = 0; i_seg < num_seg; ++i_seg) { draw_segment(i_seg, 0, height); }
+    return;
+  }
+  const unsigned int num_band = (height + band_height - 1) / band_height;
+  const float margin = style == LineStyle::Thick ? 0.5f * thickness + 1.f : 2.f;
+  const auto band_range = [&](unsigned int i_seg) -> std::pair<unsigned int, unsigned int> {
+    const float ymin = std::min(seg2xy[i_seg * 4 + 1], seg2xy[i_seg * 4 + 3]) - margin;
+    const float ymax = std::max(seg2xy[i_seg * 4 + 1], seg2xy[i_seg * 4 + 3]) + margin;
+    if (ymax < 0.f || ymin >= float(height)) { return {1, 0}; }
+    return {
+        static_cast<unsigned int>(std::max(0.f, ymin)) / band_height,
+        static_cast<unsigned int>(std::min(ymax, float(height - 1))) / band_height};
+  };
+  // register the segments to the bands in two passes (count, then fill), keeping the order
+  std::vector<unsigned int> band2idx(num_band + 1, 0);
+  for (unsigned int i_seg = 0; i_seg < num_seg; ++i_seg) {
+    const auto[ib0, ib1] = band_range(i_seg);
+    for (unsigned int ib = ib0; ib <= ib1 && ib0 <= ib1; ++ib) { band2idx[ib + 1] += 1; }
+  }
+  for (unsigned int ib = 0; ib < num_band; ++ib) { band2idx[ib + 1] += band2idx[ib]; }
+  std::vector<unsigned int> idx2seg(band2idx[num_band]);
+  {
+    std::vector<unsigned int> band2fill(band2idx.begin(), band2idx.end() - 1);
+    for (unsigned int i_seg = 0; i_seg < num_seg; ++i_seg) {
+      const auto[ib0, ib1] = band_range(i_seg);
+      for (unsigned int ib = ib0; ib <= ib1 && ib0 <= ib1; ++ib) { idx2seg[band2fill[ib]++] = i_seg; }
+    }
+  }
+  parallel_for(num_band, [&](unsigned int ib) {
+    const unsigned int row_begin = ib * band_height;
+    const unsigned int row_end = std::min(height, row_begin + band_height);
+    for (unsigned int idx = band2idx[ib]; idx < band2idx[ib + 1]; ++idx) {
+      draw_segment(idx2seg[idx], row_begin, row_end);
+    }
+  }, num_thread);
+}
+
+} // namespace acg
+
+#endif //RASTERIZE_LINE_H_
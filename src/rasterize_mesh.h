@@ -0,0 +1,295 @@
+#ifndef RASTERIZE_MESH_H_
+#define RASTERIZE_MESH_H_
+
+#include <vector>
+#include <array>
+#include <cmath>
+#include <iostream>
+#include <algorithm>
+//
+#include "Eigen/Core"
+#include "util_parallel.h"
+#include "tile_scheduler.h"
+#include "clip_triangle.h"
+
+namespace acg {
+
+/**
+ * transform the vertices to the homogeneous coordinates in batches of columns.
+ * Each batch is one matrix product over a 4xN block, which Eigen evaluates with the SIMD registers
+ * (a column of four floats is one packet), and the batches are distributed to the threads.
+ * @param transform 4x4 homogeneous transformation (e.g., from the world to the normalized device coordinate)
+ * @param vtx2xyz coordinates of the vertices (a matrix or a map of the memory, e.g., `MeshBinary::vtx2xyz`)
+ * @param num_thread number of threads (0: use all the hardware threads)
+ * @return homogeneous coordinates of the vertices
+ */
+inline Eigen::Matrix4Xf transform_vertices(
+    const Eigen::Matrix4f &transform,
+    const Eigen::Ref<const Eigen::Matrix3Xf> &vtx2xyz,
+    unsigned int num_thread = 0) {
+  constexpr unsigned int batch_size = 1024;
+  const auto num_vtx = static_cast<unsigned int>(vtx2xyz.cols());
+  Eigen::Matrix4Xf vtx2q(4, num_vtx);
+  parallel_for((num_vtx + batch_size - 1) / batch_size, [&](unsigned int i_batch) {
+    const unsigned int i0 = i_batch * batch_size;
+    const unsigned int n = std::min(batch_size, num_vtx - i0);
+    vtx2q.middleCols(i0, n).noalias() = transform.leftCols<3>() * vtx2xyz.middleCols(i0, n);
+    vtx2q.middleCols(i0, n).colwise() += transform.col(3);
+  }, num_thread);
+  return vtx2q;
+}
+
+/**
+ * Depth buffer with the reversed depth: the larger normalized device z is closer, since the near plane is
+ * mapped to z=+1 and the far plane to z=-1. The buffer is cleared to the far plane, so the fragments
+ * beyond the far plane are rejected by the depth test.
+ * The image is split into blocks of 8x8 pixels, and the farthest depth of each block is kept
+ * so that a triangle completely behind a block is rejected without visiting its pixels.
+ */
+class DepthBuffer {
+ public:
+  static constexpr unsigned int block_size = 8;
+  unsigned int width;
+  unsigned int height;
+  unsigned int num_block_x;
+  unsigned int num_block_y;
+  std::vector<float> depth; // depth of each pixel from top-left to bottom-right
+  std::vector<float> block2zmin; // farthest depth in each block
+ public:
+  DepthBuffer(unsigned int width_, unsigned int height_)
+      : width(width_), height(height_),
+        num_block_x((width_ + block_size - 1) / block_size),
+        num_block_y((height_ + block_size - 1) / block_size) {
+    clear();
+  }
+
+  void clear() {
+    depth.assign(width * height, -1.f);
+    block2zmin.assign(num_block_x * num_block_y, -1.f);
+  }
+
+  /**
+   * recompute the farthest depth of the block after its pixels are written
+   */
+  void update_block(unsigned int ix, unsigned int iy) {
+    const unsigned int iw_end = std::min(width, (ix + 1) * block_size);
+    const unsigned int ih_end = std::min(height, (iy + 1) * block_size);
+    float zmin = 1.f;
+    for (unsigned int ih = iy * block_size; ih < ih_end; ++ih) {
+      for (unsigned int iw = ix * block_size; iw < iw_end; ++iw) { zmin = std::min(zmin, depth[ih * width + iw]); }
+    }
+    block2zmin[iy * num_block_x + ix] = zmin;
+  }
+};
+
+/**
+ * Triangle after the setup. Every quantity is a plane f = a * x + b * y + c on the pixel coordinate
+ * (x to the right, y downward, pixel centers at half integers).
+ */
+class TriangleSetup {
+ public:
+  using Plane = std::array<float, 3>;
+  std::array<Plane, 3> edge; // barycentric coordinate times the area, non-negative inside the triangle
+  Plane z; // normalized device depth (affine on the screen)
+  Plane inv_w; // 1/w
+  Plane attr_w; // attribute divided by w for the perspective-correct interpolation
+  float zmax; // closest depth of the triangle
+  std::array<float, 4> bbox; // {xmin, ymin, xmax, ymax} in pixel
+
+  static float eval(const Plane &f, float x, float y) { return f[0] * x + f[1] * y + f[2]; }
+};
+
+/**
+ * set up the triangle on the screen
+ * @param q homogeneous coordinates of the corners
+ * @param attr attribute (e.g., shading intensity) at the corners
+ * @return false if the triangle is culled (back facing, degenerate or behind the camera)
+ */
+inline bool setup_triangle(
+    const std::array<Eigen::Vector4f, 3> &q,
+    const std::array<float, 3> &attr,
+    unsigned int width,
+    unsigned int height,
+    TriangleSetup &t) {
+  for (const auto &qi: q) { if (qi.w() <= 1.0e-5f) { return false; } }
+  std::array<Eigen::Vector2f, 3> p; // pixel coordinates
+  std::array<float, 3> z{}, inv_w{};
+  for (unsigned int i = 0; i < 3; ++i) {
+    inv_w[i] = 1.f / q[i].w();
+    p[i] = {(q[i].x() * inv_w[i] + 1.f) * 0.5f * float(width), (1.f - q[i].y() * inv_w[i]) * 0.5f * float(height)};
+    z[i] = q[i].z() * inv_w[i];
+  }
+  // the y axis is flipped in the pixel coordinate, so the front (counter-clockwise in NDC) faces have negative area
+  const Eigen::Vector2f d1 = p[1] - p[0], d2 = p[2] - p[0];
+  const float area = d2.x() * d1.y() - d2.y() * d1.x();
+  if (area <= 0.f) { return false; }
+  for (unsigned int i = 0; i < 3; ++i) { // cross(pb - x, pa - x) for the edge (pa, pb) opposite to the corner i
+    const Eigen::Vector2f &pa = p[(i + 1) % 3];
+    const Eigen::Vector2f &pb = p[(i + 2) % 3];
+    t.edge[i] = {pb.y() - pa.y(), pa.x() - pb.x(), pb.x() * pa.y() - pb.y() * pa.x()};
+  }
+  const auto interpolate = [&](float f0, float f1, float f2) -> TriangleSetup::Plane {
+    return {(t.edge[0][0] * f0 + t.edge[1][0] * f1 + t.edge[2][0] * f2) / area,
+            (t.edge[0][1] * f0 + t.edge[1][1] * f1 + t.edge[2][1] * f2) / area,
+            (t.edge[0][2] * f0 + t.edge[1][2] * f1 + t.edge[2][2] * f2) / area};
+  };
+  t.z = interpolate(z[0], z[1], z[2]);
+  t.inv_w = interpolate(inv_w[0], inv_w[1], inv_w[2]);
+  t.attr_w = interpolate(attr[0] * inv_w[0], attr[1] * inv_w[1], attr[2] * inv_w[2]);
+  t.zmax = std::max({z[0], z[1], z[2]});
+  t.bbox = {
+      std::min({p[0].x(), p[1].x(), p[2].x()}), std::min({p[0].y(), p[1].y(), p[2].y()}),
+      std::max({p[0].x(), p[1].x(), p[2].x()}), std::max({p[0].y(), p[1].y(), p[2].y()})};
+  return true;
+}
+
+/**
+ * draw the triangle in the rectangle of pixels with the depth test. The blocks of the depth buffer whose
+ * farthest depth is closer than the triangle, or which are outside an edge of the triangle, are skipped.
+ * @param rect pixels to draw. Its corners must be on the boundaries of the blocks of the depth buffer
+ * @param img_data grayscale image. The interpolated attribute (clamped to [0,1]) is written
+ * @return number of the blocks rejected by the hierarchical depth
+ */
+inline unsigned int draw_triangle_depth(
+    const TriangleSetup &t,
+    const PixelRect &rect,
+    DepthBuffer &depth_buffer,
+    std::vector<unsigned char> &img_data) {
+  constexpr unsigned int bs = DepthBuffer::block_size;
+  const unsigned int width = depth_buffer.width;
+  const auto to_pixel = [](float v, unsigned int lo, unsigned int hi) { // index of the pixel whose center is >= v
+    return static_cast<unsigned int>(std::clamp(std::ceil(v - 0.5f), float(lo), float(hi)));
+  };
+  const unsigned int iw0 = to_pixel(t.bbox[0], rect.iw_begin, rect.iw_end);
+  const unsigned int ih0 = to_pixel(t.bbox[1], rect.ih_begin, rect.ih_end);
+  const unsigned int iw1 = to_pixel(t.bbox[2] + 1.f, rect.iw_begin, rect.iw_end); // exclusive
+  const unsigned int ih1 = to_pixel(t.bbox[3] + 1.f, rect.ih_begin, rect.ih_end);
+  unsigned int num_rejected = 0;
+  for (unsigned int iy = ih0 / bs; iy * bs < ih1; ++iy) {
+    for (unsigned int ix = iw0 / bs; ix * bs < iw1; ++ix) {
+      if (t.zmax < depth_buffer.block2zmin[iy * depth_buffer.num_block_x + ix]) {
+        num_rejected += 1;
+        continue;
+      }
+      const unsigned int bw0 = std::max(iw0, ix * bs), bw1 = std::min(iw1, (ix + 1) * bs);
+      const unsigned int bh0 = std::max(ih0, iy * bs), bh1 = std::min(ih1, (iy + 1) * bs);
+      // the largest value of an edge function over the block is at one of the corners of the pixel centers
+      bool is_outside = false;
+      for (const auto &e: t.edge) {
+        const float x = e[0] > 0.f ? float(bw1) - 0.5f : float(bw0) + 0.5f;
+        const float y = e[1] > 0.f ? float(bh1) - 0.5f : float(bh0) + 0.5f;
+        if (TriangleSetup::eval(e, x, y) < 0.f) { is_outside = true; }
+      }
+      if (is_outside) { continue; }
+      bool is_written = false;
+      for (unsigned int ih = bh0; ih < bh1; ++ih) {
+        const float y = float(ih) + 0.5f;
+        for (unsigned int iw = bw0; iw < bw1; ++iw) {
+          const float x = float(iw) + 0.5f;
+          if (TriangleSetup::eval(t.edge[0], x, y) < 0.f
+              || TriangleSetup::eval(t.edge[1], x, y) < 0.f
+              || TriangleSetup::eval(t.edge[2], x, y) < 0.f) { continue; }
+          const float z = TriangleSetup::eval(t.z, x, y);
+          float &z_pix = depth_buffer.depth[ih * width + iw];
+          if (z <= z_pix || z > 1.f) { continue; } // behind the stored pixel or in front of the near plane
+          z_pix = z;
+          const float attr = TriangleSetup::eval(t.attr_w, x, y) / TriangleSetup::eval(t.inv_w, x, y);
+          img_data[ih * width + iw] = static_cast<unsigned char>(std::clamp(attr, 0.f, 1.f) * 255.f + 0.5f);
+          is_written = true;
+        }
+      }
+      if (is_written) { depth_buffer.update_block(ix, iy); }
+    }
+  }
+  return num_rejected;
+}
+
+/**
+ * numbers of the triangles and the blocks in drawing a mesh (see `draw_mesh_depth`)
+ */
+class DrawMeshStatistics {
+ public:
+  unsigned int num_tri = 0;
+  unsigned int num_outside = 0; // triangles culled by the view frustum
+  unsigned int num_clipped = 0; // triangles crossing the near plane or the guard band
+  unsigned int num_drawn = 0; // triangles drawn, including the fans of the clipped polygons
+  unsigned int num_rejected = 0; // blocks rejected by the hierarchical depth
+ public:
+  void print() const {
+    std::cout << "triangles: " << num_tri << ", outside the frustum " << num_outside << ", clipped " << num_clipped
+              << ", drawn " << num_drawn << ", blocks rejected by depth " << num_rejected << std::endl;
+  }
+};
+
+/**
+ * draw the triangle mesh with the depth test. The triangles outside the view frustum are culled and the triangles
+ * crossing the near plane or the guard band are clipped (see `clip_triangle`), so the cost is proportional to
+ * the visible geometry. The triangles are set up in parallel, and the image is drawn tile by tile in parallel
+ * with the tile scheduler.
+ * @param tri2vtx vertex indices of the triangles (counter-clockwise seen from the front)
+ * @param vtx2q homogeneous coordinates of the vertices (see `transform_vertices`)
+ * @param vtx2attr attribute of the vertices interpolated perspective-correctly (e.g., shading intensity in [0,1])
+ * @param img_data grayscale image
+ * @param num_thread number of threads (0: use all the hardware threads)
+ * @return numbers of the culled, clipped and drawn triangles
+ */
+inline DrawMeshStatistics draw_mesh_depth(
+    const Eigen::Ref<const Eigen::Matrix<unsigned int, 3, Eigen::Dynamic>> &tri2vtx,
+    const Eigen::Matrix4Xf &vtx2q,
+    const std::vector<float> &vtx2attr,
+    DepthBuffer &depth_buffer,
+    std::vector<unsigned char> &img_data,
+    unsigned int num_thread = 0) {
+  const auto num_tri = static_cast<unsigned int>(tri2vtx.cols());
+  std::vector<TriangleSetup> tri2setup(num_tri);
+  std::vector<ClipResult> tri2clip(num_tri, ClipResult::Outside);
+  std::vector<unsigned char> tri2visible(num_tri, 0);
+  std::vector<std::vector<TriangleSetup>> tri2fan(num_tri); // fan of the clipped polygon (empty unless clipped)
+  parallel_for(num_tri, [&](unsigned int i_tri) {
+    const unsigned int i0 = tri2vtx(0, i_tri), i1 = tri2vtx(1, i_tri), i2 = tri2vtx(2, i_tri);
+    ClippedPolygon<float> polygon;
+    tri2clip[i_tri] = clip_triangle<float>(
+        {vtx2q.col(i0), vtx2q.col(i1), vtx2q.col(i2)}, {vtx2attr[i0], vtx2attr[i1], vtx2attr[i2]}, polygon);
+    if (tri2clip[i_tri] == ClipResult::Inside) {
+      tri2visible[i_tri] = setup_triangle(
+          {vtx2q.col(i0), vtx2q.col(i1), vtx2q.col(i2)}, {vtx2attr[i0], vtx2attr[i1], vtx2attr[i2]},
+          depth_buffer.width, depth_buffer.height, tri2setup[i_tri]);
+    }
+    if (tri2clip[i_tri] != ClipResult::Clipped) { return; }
+    for (unsigned int i = 1; i + 1 < polygon.num_vtx; ++i) {
+      TriangleSetup t;
+      if (!setup_triangle(
+          {polygon.vtx2q[0], polygon.vtx2q[i], polygon.vtx2q[i + 1]},
+          {polygon.vtx2attr[0], polygon.vtx2attr[i], polygon.vtx2attr[i + 1]},
+          depth_buffer.width, depth_buffer.height, t)) { continue; }
+      tri2fan[i_tri].push_back(t);
+    }
+  }, num_thread);
+  // visible triangles in the input order. The clipped triangles are replaced by the fans of their polygons
+  std::vector<TriangleSetup> setups;
+  DrawMeshStatistics stats;
+  stats.num_tri = num_tri;
+  for (unsigned int i_tri = 0; i_tri < num_tri; ++i_tri) {
+    if (tri2clip[i_tri] == ClipResult::Outside) { stats.num_outside += 1; }
+    if (tri2clip[i_tri] == ClipResult::Clipped) { stats.num_clipped += 1; }
+    if (tri2clip[i_tri] == ClipResult::Inside && tri2visible[i_tri]) { setups.push_back(tri2setup[i_tri]); }
+    setups.insert(setups.end(), tri2fan[i_tri].begin(), tri2fan[i_tri].end());
+  }
+  //
+  TileScheduler scheduler(depth_buffer.width, depth_buffer.height, DepthBuffer::block_size * 8, num_thread);
+  scheduler.bin(static_cast<unsigned int>(setups.size()), [&](unsigned int idx) { return setups[idx].bbox; });
+  std::vector<unsigned int> tile2rejected(scheduler.num_tile(), 0);
+  scheduler.run([&](const Tile &tile) {
+    for (unsigned int i = 0; i < tile.num_prim; ++i) {
+      tile2rejected[tile.i_tile] += draw_triangle_depth(
+          setups[tile.prims[i]], tile.rect, depth_buffer, img_data);
+    }
+  });
+  stats.num_drawn = static_cast<unsigned int>(setups.size());
+  for (unsigned int n: tile2rejected) { stats.num_rejected += n; }
+  return stats;
+}
+
+} // namespace acg
+
+#endif //RASTERIZE_MESH_H_
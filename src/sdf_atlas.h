@@ -0,0 +1,342 @@
+#ifndef SDF_ATLAS_H_
+#define SDF_ATLAS_H_
+
+#include <vector>
+#include <cmath>
+#include <limits>
+#include <optional>
+#include <algorithm>
+//
+#include "Eigen/Core"
+#include "parse_svg.h"
+#include "util_bezier.h"
+#include "curve_grid.h"
+#include "util_parallel.h"
+
+namespace acg {
+
+/**
+ * distance from a point to an edge used for the multi-channel signed distance field
+ */
+class EdgeDistance {
+ public:
+  float distance = std::numeric_limits<float>::max(); // distance to the nearest point on the edge
+  float orthogonality = 0.f; // |sin| of the angle between the tangent and the direction to the point
+  float pseudo_distance = 0.f; // signed distance to the edge extended along the tangents at its end points
+ public:
+  /**
+   * At a shared end point two edges are at the same distance, then the edge seen more orthogonally is closer.
+   */
+  [[nodiscard]] bool is_closer_than(const EdgeDistance &other) const {
+    if (std::fabs(distance - other.distance) > 1.0e-6f * std::max(distance, other.distance)) {
+      return distance < other.distance;
+    }
+    return orthogonality > other.orthogonality;
+  }
+};
+
+/**
+ * distance from a point to a line segment or a quadratic Bézier curve.
+ * The sign of the pseudo distance is positive if the point is on the left of the edge direction
+ * (`cross(tangent, p - q) > 0`).
+ * @param edge line segment or quadratic Bézier curve
+ * @param p query point
+ */
+EdgeDistance edge_distance(
+    const Edge &edge,
+    const Eigen::Vector2f &p) {
+  float t;
+  Eigen::Vector2f q; // nearest point
+  Eigen::Vector2f d; // tangent at the nearest point
+  if (edge.is_bezier) {
+    t = nearest_parameter_quadratic_bezier(edge.ps, edge.pc, edge.pe, p);
+    q = quadratic_bezier_position(edge.ps, edge.pc, edge.pe, t);
+    d = 2.f * (1.f - t) * (edge.pc - edge.ps) + 2.f * t * (edge.pe - edge.pc);
+    if (d.squaredNorm() == 0.f) { d = edge.pe - edge.ps; }
+  } else {
+    d = edge.pe - edge.ps;
+    const float dd = d.squaredNorm();
+    t = dd > 0.f ? std::clamp((p - edge.ps).dot(d) / dd, 0.f, 1.f) : 0.f;
+    q = edge.ps + t * d;
+  }
+  const Eigen::Vector2f v = p - q;
+  const float len_d = d.norm();
+  const float cross = (d.x() * v.y() - d.y() * v.x()) / (len_d > 0.f ? len_d : 1.f); // distance to the tangent line
+  EdgeDistance ed;
+  ed.distance = v.norm();
+  ed.orthogonality = ed.distance > 0.f ? std::fabs(cross) / ed.distance : 1.f;
+  ed.pseudo_distance = cross >= 0.f ? ed.distance : -ed.distance;
+  if ((t == 0.f && v.dot(d) < 0.f) || (t == 1.f && v.dot(d) > 0.f)) { // beyond an end point
+    ed.pseudo_distance = cross;
+  }
+  return ed;
+}
+
+/**
+ * assign the colors (bit mask of the RGB channels) to the edges such that the two edges meeting at
+ * a sharp corner share only one channel (edge coloring of Chlumsky's multi-channel distance field).
+ * @param edges edges of the loops
+ * @param loop2idx edges of the i-th loop are edges[loop2idx[i]:loop2idx[i+1]]
+ * @param cross_threshold the tangents make a corner if |sin| of their angle is larger than this
+ * @return color of each edge
+ */
+std::vector<unsigned char> msdf_edge_colors(
+    const std::vector<Edge> &edges,
+    const std::vector<unsigned int> &loop2idx,
+    float cross_threshold = 0.14f) {
+  constexpr unsigned char white = 7, yellow = 3, cyan = 6, magenta = 5;
+  const auto tangent_start = [](const Edge &e) -> Eigen::Vector2f {
+    return (e.is_bezier && e.pc != e.ps) ? (e.pc - e.ps).normalized() : (e.pe - e.ps).normalized();
+  };
+  const auto tangent_end = [](const Edge &e) -> Eigen::Vector2f {
+    return (e.is_bezier && e.pe != e.pc) ? (e.pe - e.pc).normalized() : (e.pe - e.ps).normalized();
+  };
+  std::vector<unsigned char> edge2color(edges.size(), white);
+  for (unsigned int i_loop = 0; i_loop + 1 < loop2idx.size(); ++i_loop) {
+    const unsigned int i0 = loop2idx[i_loop];
+    const unsigned int num_edge = loop2idx[i_loop + 1] - i0;
+    std::vector<unsigned int> corners; // local index of the edges starting at a corner
+    for (unsigned int j = 0; j < num_edge; ++j) {
+      const Eigen::Vector2f a = tangent_end(edges[i0 + (j + num_edge - 1) % num_edge]);
+      const Eigen::Vector2f b = tangent_start(edges[i0 + j]);
+      if (a.dot(b) <= 0.f || std::fabs(a.x() * b.y() - a.y() * b.x()) > cross_threshold) { corners.push_back(j); }
+    }
+    if (corners.empty()) { continue; } // smooth loop: all the channels are the same
+    if (corners.size() == 1) { // tear drop: split the loop into three colors
+      for (unsigned int k = 0; k < num_edge; ++k) {
+        const unsigned char color = num_edge == 2 ? (k == 0 ? magenta : yellow) :
+                                    k * 3 < num_edge ? magenta : (k * 3 < num_edge * 2 ? white : yellow);
+        edge2color[i0 + (corners[0] + k) % num_edge] = color;
+      }
+      continue;
+    }
+    const auto num_corner = static_cast<unsigned int>(corners.size());
+    for (unsigned int i_corner = 0; i_corner < num_corner; ++i_corner) {
+      unsigned char color = (i_corner % 2 == 0) ? yellow : cyan;
+      if (num_corner % 2 == 1 && i_corner == num_corner - 1) { color = magenta; } // differs from both neighbors
+      for (unsigned int j = corners[i_corner]; j != corners[(i_corner + 1) % num_corner]; j = (j + 1) % num_edge) {
+        edge2color[i0 + j] = color;
+      }
+    }
+  }
+  return edge2color;
+}
+
+/**
+ * Atlas of multi-channel signed distance fields (MSDF) of shapes.
+ * Each shape is stored in a rectangle of the atlas at a coarse resolution, and it can be rendered
+ * at any scale with one bilinear lookup per pixel, taking the median of the three channels.
+ * The corners stay sharp because each channel is the distance to different edges at a corner.
+ */
+class SdfAtlas {
+ public:
+  class Entry {
+   public:
+    unsigned int x, y; // corner of the rectangle in the atlas
+    unsigned int width, height; // size of the rectangle in the atlas
+    Eigen::Vector2f origin; // shape coordinate of the corner of the rectangle
+    float texel_size; // size of a texel in the shape coordinate
+  };
+  unsigned int width; // width of the atlas (fixed)
+  unsigned int height = 0; // height of the atlas (grows as the shapes are added)
+  float distance_range; // distances larger than this (in texel) are clamped
+  std::vector<unsigned char> texels; // RGB, 3 bytes per texel
+  std::vector<Entry> entries;
+ private:
+  unsigned int shelf_x = 0; // the shapes are packed into the horizontal shelves
+  unsigned int shelf_y = 0;
+  unsigned int shelf_height = 0;
+ public:
+  explicit SdfAtlas(
+      unsigned int width_,
+      float distance_range_ = 4.f)
+      : width(width_), distance_range(distance_range_) {}
+
+  /**
+   * compute the distance field of a shape and pack it into the atlas
+   * @param edges edges of the closed loops of the shape
+   * @param loop2idx edges of the i-th loop are edges[loop2idx[i]:loop2idx[i+1]]
+   * @param texel_size size of a texel in the shape coordinate
+   * @param num_thread number of threads (0: use all the hardware threads)
+   * @return index of the entry (std::nullopt if the shape is wider than the atlas)
+   */
+  std::optional<unsigned int> add_shape(
+      const std::vector<Edge> &edges,
+      const std::vector<unsigned int> &loop2idx,
+      float texel_size,
+      unsigned int num_thread = 0) {
+    Eigen::Vector2f pmin = edges.empty() ? Eigen::Vector2f(0.f, 0.f) : edges[0].ps;
+    Eigen::Vector2f pmax = pmin;
+    for (const auto &edge: edges) { // the curve is inside the box of its control points
+      pmin = pmin.cwiseMin(edge.ps).cwiseMin(edge.pe);
+      pmax = pmax.cwiseMax(edge.ps).cwiseMax(edge.pe);
+      if (edge.is_bezier) {
+        pmin = pmin.cwiseMin(edge.pc);
+        pmax = pmax.cwiseMax(edge.pc);
+      }
+    }
+    const auto padding = static_cast<unsigned int>(std::ceil(distance_range)) + 1;
+    Entry entry{};
+    entry.width = static_cast<unsigned int>(std::ceil((pmax.x() - pmin.x()) / texel_size)) + 2 * padding;
+    entry.height = static_cast<unsigned int>(std::ceil((pmax.y() - pmin.y()) / texel_size)) + 2 * padding;
+    entry.origin = pmin - Eigen::Vector2f(float(padding), float(padding)) * texel_size;
+    entry.texel_size = texel_size;
+    if (entry.width > width) { return std::nullopt; } // the rows of the rectangle would overrun the atlas
+    if (shelf_x + entry.width > width) { // start a new shelf
+      shelf_y += shelf_height;
+      shelf_x = 0;
+      shelf_height = 0;
+    }
+    entry.x = shelf_x;
+    entry.y = shelf_y;
+    shelf_x += entry.width;
+    shelf_height = std::max(shelf_height, entry.height);
+    height = std::max(height, shelf_y + entry.height);
+    texels.resize(width * height * 3, 0);
+    compute_distance_field(entry, edges, loop2idx, num_thread);
+    entries.push_back(entry);
+    return static_cast<unsigned int>(entries.size() - 1);
+  }
+
+  /**
+   * signed distance reconstructed from the atlas (positive inside)
+   * @param i_entry index of the shape
+   * @param p point in the shape coordinate
+   * @return signed distance in the shape coordinate
+   */
+  [[nodiscard]] float signed_distance(
+      unsigned int i_entry,
+      const Eigen::Vector2f &p) const {
+    const Entry &entry = entries[i_entry];
+    const float u = std::clamp((p.x() - entry.origin.x()) / entry.texel_size - 0.5f, 0.f, float(entry.width - 1));
+    const float v = std::clamp((p.y() - entry.origin.y()) / entry.texel_size - 0.5f, 0.f, float(entry.height - 1));
+    const auto iu = std::min(static_cast<unsigned int>(u), entry.width - 2);
+    const auto iv = std::min(static_cast<unsigned int>(v), entry.height - 2);
+    const float fu = u - float(iu);
+    const float fv = v - float(iv);
+    float c[3];
+    for (unsigned int i_ch = 0; i_ch < 3; ++i_ch) {
+      const auto texel = [&](unsigned int du, unsigned int dv) {
+        return float(texels[((entry.y + iv + dv) * width + entry.x + iu + du) * 3 + i_ch]);
+      };
+      c[i_ch] = (1.f - fv) * ((1.f - fu) * texel(0, 0) + fu * texel(1, 0))
+          + fv * ((1.f - fu) * texel(0, 1) + fu * texel(1, 1));
+    }
+    const float median = std::max(std::min(c[0], c[1]), std::min(std::max(c[0], c[1]), c[2]));
+    return (median / 255.f - 0.5f) * 2.f * distance_range * entry.texel_size;
+  }
+
+  /**
+   * render the shape with anti-aliasing
+   * @param i_entry index of the shape
+   * @param img_width width of the output image
+   * @param img_height height of the output image
+   * @param scale pixels per unit length of the shape coordinate
+   * @param num_thread number of threads (0: use all the hardware threads)
+   * @return coverage in [0,1] of each pixel
+   */
+  [[nodiscard]] std::vector<float> render_coverage(
+      unsigned int i_entry,
+      unsigned int img_width,
+      unsigned int img_height,
+      float scale,
+      unsigned int num_thread = 0) const {
+    std::vector<float> pix2coverage(img_width * img_height);
+    parallel_for(img_height, [&](unsigned int ih) {
+      for (unsigned int iw = 0; iw < img_width; ++iw) {
+        const Eigen::Vector2f p((float(iw) + 0.5f) / scale, (float(ih) + 0.5f) / scale);
+        const float sd_pixel = signed_distance(i_entry, p) * scale;
+        pix2coverage[ih * img_width + iw] = std::clamp(0.5f + sd_pixel, 0.f, 1.f);
+      }
+    }, num_thread);
+    return pix2coverage;
+  }
+
+ private:
+  void compute_distance_field(
+      const Entry &entry,
+      const std::vector<Edge> &edges,
+      const std::vector<unsigned int> &loop2idx,
+      unsigned int num_thread) {
+    const CurveGrid grid(edges); // inside/outside test
+    const float range = distance_range * entry.texel_size; // in the shape coordinate
+    // orient the loops so that the pseudo distance is positive inside
+    std::vector<float> edge2sign(edges.size(), 1.f);
+    for (unsigned int i_loop = 0; i_loop + 1 < loop2idx.size(); ++i_loop) {
+      unsigned int i_longest = loop2idx[i_loop];
+      for (unsigned int i_edge = loop2idx[i_loop]; i_edge < loop2idx[i_loop + 1]; ++i_edge) {
+        if ((edges[i_edge].pe - edges[i_edge].ps).norm() > (edges[i_longest].pe - edges[i_longest].ps).norm()) {
+          i_longest = i_edge;
+        }
+      }
+      const Edge &e = edges[i_longest];
+      const Eigen::Vector2f q = e.is_bezier ? quadratic_bezier_position(e.ps, e.pc, e.pe, 0.5f) : 0.5f * (e.ps + e.pe);
+      const Eigen::Vector2f d = e.pe - e.ps; // tangent at the middle (also for the quadratic Bézier curve)
+      const Eigen::Vector2f q_left = q + 1.0e-3f * Eigen::Vector2f(-d.y(), d.x());
+      const float sign = grid.is_inside(q_left) ? 1.f : -1.f;
+      for (unsigned int i_edge = loop2idx[i_loop]; i_edge < loop2idx[i_loop + 1]; ++i_edge) {
+        edge2sign[i_edge] = sign;
+      }
+    }
+    const std::vector<unsigned char> edge2color = msdf_edge_colors(edges, loop2idx);
+    // register the edges to the blocks of texels within the distance range
+    constexpr unsigned int block_size = 8;
+    const unsigned int num_block_x = (entry.width + block_size - 1) / block_size;
+    const unsigned int num_block_y = (entry.height + block_size - 1) / block_size;
+    std::vector<std::vector<unsigned int>> block2edges(num_block_x * num_block_y);
+    const float block_length = float(block_size) * entry.texel_size;
+    for (unsigned int i_edge = 0; i_edge < edges.size(); ++i_edge) {
+      const Edge &e = edges[i_edge];
+      Eigen::Vector2f bmin = e.ps.cwiseMin(e.pe);
+      Eigen::Vector2f bmax = e.ps.cwiseMax(e.pe);
+      if (e.is_bezier) {
+        bmin = bmin.cwiseMin(e.pc);
+        bmax = bmax.cwiseMax(e.pc);
+      }
+      const Eigen::Vector2f b0 = (bmin - entry.origin).array() / block_length - range / block_length;
+      const Eigen::Vector2f b1 = (bmax - entry.origin).array() / block_length + range / block_length;
+      const auto ix0 = static_cast<unsigned int>(std::clamp(std::floor(b0.x()), 0.f, float(num_block_x - 1)));
+      const auto iy0 = static_cast<unsigned int>(std::clamp(std::floor(b0.y()), 0.f, float(num_block_y - 1)));
+      const auto ix1 = static_cast<unsigned int>(std::clamp(std::floor(b1.x()), 0.f, float(num_block_x - 1)));
+      const auto iy1 = static_cast<unsigned int>(std::clamp(std::floor(b1.y()), 0.f, float(num_block_y - 1)));
+      for (unsigned int iy = iy0; iy <= iy1; ++iy) {
+        for (unsigned int ix = ix0; ix <= ix1; ++ix) {
+          block2edges[iy * num_block_x + ix].push_back(i_edge);
+        }
+      }
+    }
+    parallel_for(entry.height, [&](unsigned int iy) {
+      for (unsigned int ix = 0; ix < entry.width; ++ix) {
+        const Eigen::Vector2f p = entry.origin + Eigen::Vector2f(float(ix) + 0.5f, float(iy) + 0.5f) * entry.texel_size;
+        EdgeDistance nearest[3]; // nearest edge for each channel
+        float min_distance = range;
+        for (unsigned int i_edge: block2edges[(iy / block_size) * num_block_x + ix / block_size]) {
+          EdgeDistance ed = edge_distance(edges[i_edge], p);
+          ed.pseudo_distance *= edge2sign[i_edge];
+          min_distance = std::min(min_distance, ed.distance);
+          for (unsigned int i_ch = 0; i_ch < 3; ++i_ch) {
+            if ((edge2color[i_edge] >> i_ch) & 1 && ed.is_closer_than(nearest[i_ch])) { nearest[i_ch] = ed; }
+          }
+        }
+        const float sign = grid.is_inside(p) ? 1.f : -1.f;
+        float sd[3];
+        for (unsigned int i_ch = 0; i_ch < 3; ++i_ch) {
+          sd[i_ch] = nearest[i_ch].distance < range ? nearest[i_ch].pseudo_distance : sign * range;
+        }
+        const float median = std::max(std::min(sd[0], sd[1]), std::min(std::max(sd[0], sd[1]), sd[2]));
+        if ((median > 0.f) != (sign > 0.f)) { // the channels disagree with the exact inside test
+          sd[0] = sd[1] = sd[2] = sign * min_distance;
+        }
+        unsigned char *texel = texels.data() + ((entry.y + iy) * width + entry.x + ix) * 3;
+        for (unsigned int i_ch = 0; i_ch < 3; ++i_ch) {
+          const float c = std::clamp(0.5f + sd[i_ch] / (2.f * range), 0.f, 1.f);
+          texel[i_ch] = static_cast<unsigned char>(std::lround(c * 255.f));
+        }
+      }
+    }, num_thread);
+  }
+};
+
+} // namespace acg
+
+#endif //SDF_ATLAS_H_
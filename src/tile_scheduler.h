@@ -0,0 +1,168 @@
+#ifndef TILE_SCHEDULER_H_
+#define TILE_SCHEDULER_H_
+
+#include <vector>
+#include <array>
+#include <cmath>
+#include <chrono>
+#include <climits>
+#include <iostream>
+#include <algorithm>
+//
+#include "util_parallel.h"
+
+namespace acg {
+
+/**
+ * Rectangle of the pixels [iw_begin, iw_end) x [ih_begin, ih_end)
+ */
+class PixelRect {
+ public:
+  unsigned int iw_begin = 0;
+  unsigned int ih_begin = 0;
+  unsigned int iw_end = UINT_MAX;
+  unsigned int ih_end = UINT_MAX;
+};
+
+/**
+ * Tile with the primitives overlapping it
+ */
+class Tile {
+ public:
+  unsigned int i_tile;
+  PixelRect rect;
+  const unsigned int *prims; // indices of the primitives in the order of the input
+  unsigned int num_prim;
+};
+
+/**
+ * Scheduler splitting the image into square tiles that are rasterized concurrently.
+ * The primitives are binned to the tiles overlapping their bounding boxes, and each tile is drawn
+ * by one thread with the pixels clipped to the tile, so the framebuffer needs no lock.
+ * The time spent for each tile is recorded to find the imbalance of the load.
+ */
+class TileScheduler {
+ public:
+  unsigned int width;
+  unsigned int height;
+  unsigned int tile_size;
+  unsigned int num_tile_x;
+  unsigned int num_tile_y;
+  std::vector<unsigned int> tile2idx; // primitives of the i-th tile are idx2prim[tile2idx[i]:tile2idx[i+1]]
+  std::vector<unsigned int> idx2prim;
+  std::vector<double> tile2time; // time to draw each tile in the last `run` (milliseconds)
+ public:
+  /**
+   * @param tile_size size of a tile in pixel. 64x64 pixels of a few bytes fit in the L1/L2 cache
+   * @param num_thread number of threads (0: use all the hardware threads)
+   */
+  TileScheduler(
+      unsigned int width_,
+      unsigned int height_,
+      unsigned int tile_size_ = 64,
+      unsigned int num_thread = 0)
+      : width(width_), height(height_), tile_size(tile_size_),
+        num_tile_x((width_ + tile_size_ - 1) / tile_size_),
+        num_tile_y((height_ + tile_size_ - 1) / tile_size_),
+        tile2idx(num_tile_x * num_tile_y + 1, 0),
+        tile2time(num_tile_x * num_tile_y, 0.),
+        pool(num_thread) {}
+
+  [[nodiscard]] unsigned int num_tile() const { return num_tile_x * num_tile_y; }
+
+  /**
+   * register the primitives to the tiles overlapping their bounding boxes
+   * @param num_prim number of the primitives
+   * @param bbox function returning the bounding box {xmin, ymin, xmax, ymax} of the i-th primitive in pixel
+   */
+  template<typename BBOX>
+  void bin(unsigned int num_prim, BBOX &&bbox) {
+    std::vector<std::array<unsigned int, 4>> prim2range(num_prim); // range of the tiles {x0, y0, x1, y1}
+    std::fill(tile2idx.begin(), tile2idx.end(), 0);
+    for (unsigned int i_prim = 0; i_prim < num_prim; ++i_prim) {
+      const std::array<float, 4> b = bbox(i_prim);
+      if (b[2] < 0.f || b[3] < 0.f || b[0] >= float(width) || b[1] >= float(height) || !(b[0] <= b[2] && b[1] <= b[3])) {
+        prim2range[i_prim] = {1, 1, 0, 0}; // outside the image (or the box has NaN)
+        continue;
+      }
+      const auto tile_of = [&](float v, unsigned int num) { // clamped before the cast (e.g., inf for w near zero)
+        return std::min(static_cast<unsigned int>(std::clamp(v, 0.f, float(num * tile_size))) / tile_size, num - 1);
+      };
+      prim2range[i_prim] = {
+          tile_of(b[0], num_tile_x), tile_of(b[1], num_tile_y), tile_of(b[2], num_tile_x), tile_of(b[3], num_tile_y)};
+    }
+    // count, then fill keeping the order of the primitives
+    for (const auto &r: prim2range) {
+      for (unsigned int iy = r[1]; iy <= r[3] && r[1] <= r[3]; ++iy) {
+        for (unsigned int ix = r[0]; ix <= r[2] && r[0] <= r[2]; ++ix) { tile2idx[iy * num_tile_x + ix + 1] += 1; }
+      }
+    }
+    for (unsigned int i_tile = 0; i_tile < num_tile(); ++i_tile) { tile2idx[i_tile + 1] += tile2idx[i_tile]; }
+    idx2prim.resize(tile2idx[num_tile()]);
+    std::vector<unsigned int> tile2fill(tile2idx.begin(), tile2idx.end() - 1);
+    for (unsigned int i_prim = 0; i_prim < num_prim; ++i_prim) {
+      const auto &r = prim2range[i_prim];
+      for (unsigned int iy = r[1]; iy <= r[3] && r[1] <= r[3]; ++iy) {
+        for (unsigned int ix = r[0]; ix <= r[2] && r[0] <= r[2]; ++ix) {
+          idx2prim[tile2fill[iy * num_tile_x + ix]++] = i_prim;
+        }
+      }
+    }
+  }
+
+  /**
+   * call `func(tile)` for every tile concurrently. The tiles with more primitives are started first.
+   * @param func function drawing the primitives of the tile only in `tile.rect`
+   */
+  template<typename FUNC>
+  void run(FUNC &&func) {
+    std::vector<unsigned int> order(num_tile());
+    for (unsigned int i_tile = 0; i_tile < num_tile(); ++i_tile) { order[i_tile] = i_tile; }
+    std::stable_sort(order.begin(), order.end(), [&](unsigned int a, unsigned int b) {
+      return tile2idx[a + 1] - tile2idx[a] > tile2idx[b + 1] - tile2idx[b];
+    });
+    pool.parallel_for(num_tile(), [&](unsigned int i_order) {
+      const unsigned int i_tile = order[i_order];
+      const unsigned int ix = i_tile % num_tile_x;
+      const unsigned int iy = i_tile / num_tile_x;
+      Tile tile{};
+      tile.i_tile = i_tile;
+      tile.rect.iw_begin = ix * tile_size;
+      tile.rect.ih_begin = iy * tile_size;
+      tile.rect.iw_end = std::min(width, (ix + 1) * tile_size);
+      tile.rect.ih_end = std::min(height, (iy + 1) * tile_size);
+      tile.prims = idx2prim.data() + tile2idx[i_tile];
+      tile.num_prim = tile2idx[i_tile + 1] - tile2idx[i_tile];
+      const auto start = std::chrono::steady_clock::now();
+      func(tile);
+      const auto end = std::chrono::steady_clock::now();
+      tile2time[i_tile] = std::chrono::duration<double, std::milli>(end - start).count();
+    });
+  }
+
+  /**
+   * print the number of the tiles, the total/mean/max time of the tiles and the slowest tile
+   */
+  void print_statistics() const {
+    if (num_tile() == 0) { return; }
+    double sum = 0.;
+    unsigned int i_slowest = 0;
+    for (unsigned int i_tile = 0; i_tile < num_tile(); ++i_tile) {
+      sum += tile2time[i_tile];
+      if (tile2time[i_tile] > tile2time[i_slowest]) { i_slowest = i_tile; }
+    }
+    std::cout << "tiles: " << num_tile_x << "x" << num_tile_y << " (" << tile_size << "px), "
+              << pool.num_thread() << " threads, "
+              << "total " << sum << " ms, mean " << sum / num_tile() << " ms, "
+              << "max " << tile2time[i_slowest] << " ms at tile (" << i_slowest % num_tile_x << ","
+              << i_slowest / num_tile_x << ") with " << tile2idx[i_slowest + 1] - tile2idx[i_slowest]
+              << " primitives" << std::endl;
+  }
+
+ private:
+  ThreadPool pool;
+};
+
+} // namespace acg
+
+#endif //TILE_SCHEDULER_H_
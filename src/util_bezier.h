@@ -0,0 +1,243 @@
+#ifndef UTIL_BEZIER_H_
+#define UTIL_BEZIER_H_
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+//
+#include "Eigen/Core"
+#include "parse_svg.h"
+
+namespace acg {
+
+/**
+ * position on the quadratic Bézier curve
+ * @param ps start point
+ * @param pc control point
+ * @param pe end point
+ * @param t parameter in [0,1]
+ */
+Eigen::Vector2f quadratic_bezier_position(
+    const Eigen::Vector2f &ps,
+    const Eigen::Vector2f &pc,
+    const Eigen::Vector2f &pe,
+    float t) {
+  return (1.f - t) * (1.f - t) * ps + 2.f * t * (1.f - t) * pc + t * t * pe;
+}
+
+/**
+ * parameter where one coordinate of the quadratic Bézier curve takes the given value.
+ * The coordinate must be monotone on the curve and the value must be between the end points.
+ * @param s coordinate of the start point
+ * @param c coordinate of the control point
+ * @param e coordinate of the end point
+ * @param v value of the coordinate
+ * @return parameter in [0,1]
+ */
+float parameter_of_monotone_quadratic_bezier(
+    float s, float c, float e,
+    float v) {
+  // solve a t^2 + b t + d = 0
+  const float a = s - 2.f * c + e;
+  const float b = 2.f * (c - s);
+  const float d = s - v;
+  float t;
+  if (std::fabs(a) <= 1.0e-6f * (std::fabs(b) + 1.0e-20f)) { // almost linear
+    t = -d / b;
+  } else {
+    const float sqrt_disc = std::sqrt(std::max(0.f, b * b - 4.f * a * d));
+    const float q = -0.5f * (b + (b >= 0.f ? sqrt_disc : -sqrt_disc)); // avoid cancellation
+    const float t0 = q / a;
+    const float t1 = d / q;
+    t = (t0 >= -1.0e-4f && t0 <= 1.f + 1.0e-4f) ? t0 : t1;
+  }
+  return std::clamp(t, 0.f, 1.f);
+}
+
+/**
+ * split the quadratic Bézier curve at the given parameter (de Casteljau's algorithm)
+ * @return two curves (first half and second half)
+ */
+std::pair<Edge, Edge> split_quadratic_bezier(
+    const Eigen::Vector2f &ps,
+    const Eigen::Vector2f &pc,
+    const Eigen::Vector2f &pe,
+    float t) {
+  const Eigen::Vector2f p01 = (1.f - t) * ps + t * pc;
+  const Eigen::Vector2f p12 = (1.f - t) * pc + t * pe;
+  const Eigen::Vector2f p = (1.f - t) * p01 + t * p12;
+  return {Edge(ps, p01, p), Edge(p, p12, pe)};
+}
+
+/**
+ * parameter where one coordinate of the quadratic Bézier curve is extremal
+ * @param s coordinate of the start point
+ * @param c coordinate of the control point
+ * @param e coordinate of the end point
+ * @return parameter in (0,1), or -1 if the coordinate is monotone on the curve
+ */
+float parameter_extremum_quadratic_bezier(
+    float s, float c, float e) {
+  const float denominator = s - 2.f * c + e;
+  const float t = denominator != 0.f ? (s - c) / denominator : -1.f;
+  return (t > 0.f && t < 1.f) ? t : -1.f;
+}
+
+/**
+ * split the edges at the extrema of the coordinates so that each piece is monotone.
+ * @param edges line segments and quadratic Bézier curves of closed loops
+ * @param is_split_x split also at the extrema of the x-coordinate if true (otherwise only the y-coordinate)
+ * @return list of pieces
+ */
+std::vector<Edge> monotone_pieces(
+    const std::vector<Edge> &edges,
+    bool is_split_x) {
+  std::vector<Edge> pieces;
+  pieces.reserve(edges.size());
+  for (const auto &edge: edges) {
+    if (!edge.is_bezier) {
+      pieces.push_back(edge);
+      continue;
+    }
+    float ts[2] = {
+        parameter_extremum_quadratic_bezier(edge.ps.y(), edge.pc.y(), edge.pe.y()),
+        is_split_x ? parameter_extremum_quadratic_bezier(edge.ps.x(), edge.pc.x(), edge.pe.x()) : -1.f};
+    if (ts[0] > ts[1]) { std::swap(ts[0], ts[1]); }
+    Edge rest = edge;
+    float t_rest = 0.f; // parameter of the original curve at the start of the rest
+    for (float t: ts) {
+      if (t <= t_rest) { continue; } // no extremum or the same extremum
+      const auto[first, second] = split_quadratic_bezier(rest.ps, rest.pc, rest.pe, (t - t_rest) / (1.f - t_rest));
+      pieces.push_back(first);
+      rest = second;
+      t_rest = t;
+    }
+    pieces.push_back(rest);
+  }
+  return pieces;
+}
+
+/**
+ * split the edges at the extrema of the y-coordinate so that each piece is monotone in y.
+ * A horizontal line then crosses each piece at most once.
+ * @param edges line segments and quadratic Bézier curves of closed loops
+ * @return list of pieces
+ */
+std::vector<Edge> y_monotone_pieces(
+    const std::vector<Edge> &edges) {
+  return monotone_pieces(edges, false);
+}
+
+/**
+ * x-coordinate where the horizontal line crosses the y-monotone piece.
+ * The line y = v crosses the piece if `(ps.y() <= v) != (pe.y() <= v)` so the shared end points are counted once.
+ * @param piece line segment or y-monotone quadratic Bézier curve
+ * @param v y-coordinate of the horizontal line
+ * @return x-coordinate of the crossing point
+ */
+float x_crossing_horizontal_line(
+    const Edge &piece,
+    float v) {
+  if (!piece.is_bezier) {
+    return piece.ps.x() + (v - piece.ps.y()) * (piece.pe.x() - piece.ps.x()) / (piece.pe.y() - piece.ps.y());
+  }
+  const float t = parameter_of_monotone_quadratic_bezier(piece.ps.y(), piece.pc.y(), piece.pe.y(), v);
+  return quadratic_bezier_position(piece.ps, piece.pc, piece.pe, t).x();
+}
+
+/**
+ * y-coordinate where the vertical line crosses the x-monotone piece.
+ * The line x = v crosses the piece if `(ps.x() <= v) != (pe.x() <= v)`.
+ * @param piece line segment or x-monotone quadratic Bézier curve
+ * @param v x-coordinate of the vertical line
+ * @return y-coordinate of the crossing point
+ */
+float y_crossing_vertical_line(
+    const Edge &piece,
+    float v) {
+  if (!piece.is_bezier) {
+    return piece.ps.y() + (v - piece.ps.x()) * (piece.pe.y() - piece.ps.y()) / (piece.pe.x() - piece.ps.x());
+  }
+  const float t = parameter_of_monotone_quadratic_bezier(piece.ps.x(), piece.pc.x(), piece.pe.x(), v);
+  return quadratic_bezier_position(piece.ps, piece.pc, piece.pe, t).y();
+}
+
+/**
+ * real roots of the cubic equation x^3 + a x^2 + b x + c = 0
+ * @param[out] roots real roots
+ * @return number of the real roots (1 to 3)
+ */
+unsigned int real_roots_of_normalized_cubic(
+    double a, double b, double c,
+    double roots[3]) {
+  const double q = (a * a - 3. * b) / 9.;
+  const double r = (a * (2. * a * a - 9. * b) + 27. * c) / 54.;
+  const double q3 = q * q * q;
+  const double a3 = a / 3.;
+  if (r * r < q3) { // three real roots (trigonometric solution)
+    const double theta = std::acos(std::clamp(r / std::sqrt(q3), -1., 1.));
+    const double m = -2. * std::sqrt(q);
+    constexpr double two_pi = 6.283185307179586;
+    roots[0] = m * std::cos(theta / 3.) - a3;
+    roots[1] = m * std::cos((theta + two_pi) / 3.) - a3;
+    roots[2] = m * std::cos((theta - two_pi) / 3.) - a3;
+    return 3;
+  }
+  const double u = (r < 0. ? 1. : -1.) * std::cbrt(std::fabs(r) + std::sqrt(r * r - q3)); // Cardano's formula
+  const double v = u == 0. ? 0. : q / u;
+  roots[0] = (u + v) - a3;
+  if (std::fabs(u - v) <= 1.0e-12 * std::fabs(u + v)) { // double root
+    roots[1] = -0.5 * (u + v) - a3;
+    return 2;
+  }
+  return 1;
+}
+
+/**
+ * parameter of the point on the quadratic Bézier curve nearest to a point.
+ * The stationary points of the squared distance are the roots of a cubic equation.
+ * @param ps start point
+ * @param pc control point
+ * @param pe end point
+ * @param p query point
+ * @return parameter in [0,1]
+ */
+float nearest_parameter_quadratic_bezier(
+    const Eigen::Vector2f &ps,
+    const Eigen::Vector2f &pc,
+    const Eigen::Vector2f &pe,
+    const Eigen::Vector2f &p) {
+  const Eigen::Vector2d a = (pc - ps).cast<double>();
+  const Eigen::Vector2d b = (ps - 2.f * pc + pe).cast<double>();
+  const Eigen::Vector2d m = (ps - p).cast<double>();
+  const auto sqdist = [&](double t) { return (m + 2. * t * a + t * t * b).squaredNorm(); };
+  double t_best = 0.;
+  double sqdist_best = sqdist(0.);
+  if (sqdist(1.) < sqdist_best) {
+    t_best = 1.;
+    sqdist_best = sqdist(1.);
+  }
+  const double bb = b.squaredNorm();
+  if (bb < 1.0e-12 * a.squaredNorm()) { // almost a line segment
+    const Eigen::Vector2d d = (pe - ps).cast<double>();
+    const double t = d.squaredNorm() > 0. ? std::clamp(-m.dot(d) / d.squaredNorm(), 0., 1.) : 0.;
+    return sqdist(t) < sqdist_best ? float(t) : float(t_best);
+  }
+  // (B(t) - p).dot(B'(t)) / 2 = bb t^3 + 3 a.b t^2 + (2 a.a + m.b) t + m.a
+  double roots[3];
+  const unsigned int num_root = real_roots_of_normalized_cubic(
+      3. * a.dot(b) / bb, (2. * a.squaredNorm() + m.dot(b)) / bb, m.dot(a) / bb, roots);
+  for (unsigned int i_root = 0; i_root < num_root; ++i_root) {
+    if (roots[i_root] <= 0. || roots[i_root] >= 1.) { continue; }
+    const double d2 = sqdist(roots[i_root]);
+    if (d2 < sqdist_best) {
+      t_best = roots[i_root];
+      sqdist_best = d2;
+    }
+  }
+  return float(t_best);
+}
+
+} // namespace acg
+
+#endif //UTIL_BEZIER_H_
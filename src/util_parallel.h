@@ -0,0 +1,151 @@
+#ifndef UTIL_PARALLEL_H_
+#define UTIL_PARALLEL_H_
+
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <algorithm>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <cstdint>
+
+namespace acg {
+
+/**
+ * number of threads used by default
+ * @return number of hardware threads (at least one)
+ */
+unsigned int num_default_threads() {
+  return std::max(1u, std::thread::hardware_concurrency());
+}
+
+/**
+ * call `func(i)` for every `i` in [0, num) using multiple threads.
+ * The items are distributed dynamically, so `func` can take different time for each item.
+ * @param num number of items
+ * @param func function called for each item. Calls with different `i` must not write to the same memory
+ * @param num_thread number of threads (0: use all the hardware threads)
+ */
+template<typename FUNC>
+void parallel_for(
+    unsigned int num,
+    FUNC &&func,
+    unsigned int num_thread = 0) {
+  if (num_thread == 0) { num_thread = num_default_threads(); }
+  num_thread = std::min(num_thread, num);
+  if (num_thread <= 1) {
+    for (unsigned int i = 0; i < num; ++i) { func(i); }
+    return;
+  }
+  std::atomic<unsigned int> counter(0);
+  auto worker = [&]() {
+    for (;;) {
+      const unsigned int i = counter.fetch_add(1);
+      if (i >= num) { break; }
+      func(i);
+    }
+  };
+  std::vector<std::thread> threads;
+  for (unsigned int i_thread = 1; i_thread < num_thread; ++i_thread) { threads.emplace_back(worker); }
+  worker();
+  for (auto &thread: threads) { thread.join(); }
+}
+
+/**
+ * Threads kept alive between the parallel loops. Starting the threads for every loop costs tens of
+ * microseconds, which matters when many small loops are run (e.g., one loop per frame).
+ */
+class ThreadPool {
+ public:
+  /**
+   * @param num_thread number of threads including the calling thread (0: use all the hardware threads)
+   */
+  explicit ThreadPool(unsigned int num_thread = 0) {
+    if (num_thread == 0) { num_thread = num_default_threads(); }
+    for (unsigned int i_thread = 1; i_thread < num_thread; ++i_thread) {
+      workers.emplace_back([this]() { work(); });
+    }
+  }
+
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  ~ThreadPool() {
+    {
+      std::lock_guard<std::mutex> lock(mtx);
+      is_stop = true;
+    }
+    cv_start.notify_all();
+    for (auto &worker: workers) { worker.join(); }
+  }
+
+  [[nodiscard]] unsigned int num_thread() const { return static_cast<unsigned int>(workers.size() + 1); }
+
+  /**
+   * call `func(i)` for every `i` in [0, num) using the threads of the pool. It returns when all the calls finish.
+   * @param num number of items
+   * @param func function called for each item. Calls with different `i` must not write to the same memory
+   */
+  void parallel_for(
+      unsigned int num,
+      const std::function<void(unsigned int)> &func) {
+    if (workers.empty() || num <= 1) {
+      for (unsigned int i = 0; i < num; ++i) { func(i); }
+      return;
+    }
+    {
+      std::lock_guard<std::mutex> lock(mtx);
+      job = &func;
+      num_item = num;
+      counter = 0;
+      num_busy = static_cast<unsigned int>(workers.size());
+      ++generation;
+    }
+    cv_start.notify_all();
+    run_items(func, num);
+    std::unique_lock<std::mutex> lock(mtx);
+    cv_done.wait(lock, [this]() { return num_busy == 0; });
+    job = nullptr;
+  }
+
+ private:
+  void run_items(const std::function<void(unsigned int)> &func, unsigned int num) {
+    for (;;) {
+      const unsigned int i = counter.fetch_add(1);
+      if (i >= num) { break; }
+      func(i);
+    }
+  }
+
+  void work() {
+    uint64_t generation_done = 0;
+    for (;;) {
+      std::unique_lock<std::mutex> lock(mtx);
+      cv_start.wait(lock, [&]() { return is_stop || generation != generation_done; });
+      if (is_stop) { return; }
+      generation_done = generation;
+      const std::function<void(unsigned int)> &func = *job;
+      const unsigned int num = num_item;
+      lock.unlock();
+      run_items(func, num);
+      lock.lock();
+      if (--num_busy == 0) { cv_done.notify_one(); }
+    }
+  }
+
+  std::vector<std::thread> workers;
+  std::mutex mtx;
+  std::condition_variable cv_start;
+  std::condition_variable cv_done;
+  const std::function<void(unsigned int)> *job = nullptr;
+  unsigned int num_item = 0;
+  std::atomic<unsigned int> counter{0};
+  unsigned int num_busy = 0;
+  uint64_t generation = 0;
+  bool is_stop = false;
+};
+
+} // namespace acg
+
+#endif //UTIL_PARALLEL_H_
@@ -6,113 +6,301 @@
 #define READ_OBJ_FILE_H_
 
 #include <vector>
-#include <fstream>
-#include <filesystem>
-#include <sstream>
+#include <array>
 #include <tuple>
+#include <utility>
+#include <optional>
+#include <charconv>
+#include <climits>
+#include <algorithm>
+#include <iostream>
+#include <filesystem>
 //
 #include "Eigen/Dense"
+#include "mapped_file.h"
+#include "util_parallel.h"
 
 namespace acg {
 
+/**
+ * Contents of a Wavefront OBJ file. The polygons are split into triangles as fans from their first corners.
+ * The corners of a triangle can refer to different indices for the position, the texture coordinate and the normal.
+ */
+class WavefrontObj {
+ public:
+  std::vector<float> vtx2xyz; // positions (x,y,z) of the "v" lines
+  std::vector<float> vtx2uv; // texture coordinates (u,v) of the "vt" lines
+  std::vector<float> vtx2nrm; // normals (x,y,z) of the "vn" lines
+  std::vector<unsigned int> tri2vtx; // position indices of the three corners of each triangle
+  std::vector<unsigned int> tri2uv; // texture coordinate indices of the corners (UINT_MAX if not given)
+  std::vector<unsigned int> tri2nrm; // normal indices of the corners (UINT_MAX if not given)
+};
+
+/**
+ * load the Wavefront OBJ file in parallel. The file is memory mapped and split into chunks at line breaks.
+ * In the first pass, each chunk counts its vertices and triangles, and the prefix sums of the counts give where
+ * the chunk writes its results. In the second pass, each chunk parses the numbers with `std::from_chars` into
+ * the arrays allocated beforehand, so no memory is allocated per line.
+ * Faces with any number of corners, negative (relative) indices and the "v/vt/vn", "v//vn" and "v/vt" corners are supported.
+ * @param num_thread number of threads (0: use all the hardware threads)
+ * @return std::nullopt if the file cannot be opened or a face refers to a vertex that does not exist
+ * (an empty file gives an empty mesh)
+ */
+inline std::optional<WavefrontObj> read_wavefrontobj(
+    const std::filesystem::path &file_path,
+    unsigned int num_thread = 0) {
+  const MappedFile file(file_path);
+  if (!file.is_open()) { // an empty file is not mapped, but it is an empty mesh
+    std::error_code ec;
+    if (std::filesystem::is_regular_file(file_path, ec) && std::filesystem::file_size(file_path, ec) == 0 && !ec) {
+      return WavefrontObj{};
+    }
+    return std::nullopt;
+  }
+  const char *const str = file.data();
+  const size_t size = file.size();
+  // chunks of about 1MB ending at line breaks
+  constexpr size_t chunk_size = 1u << 20;
+  std::vector<size_t> chunk2pos = {0};
+  while (chunk2pos.back() < size) {
+    size_t pos = std::min(size, chunk2pos.back() + chunk_size);
+    while (pos < size && str[pos - 1] != '\n') { ++pos; }
+    chunk2pos.push_back(pos);
+  }
+  const auto num_chunk = static_cast<unsigned int>(chunk2pos.size() - 1);
+  // call `func(kind, s, end)` for every line of the chunk with the pointer `s` just after the keyword.
+  // The line ends at the comment (`#`), so both passes see the same elements
+  const auto for_each_line = [&](unsigned int i_chunk, auto &&func) {
+    const char *s = str + chunk2pos[i_chunk];
+    const char *const end = str + chunk2pos[i_chunk + 1];
+    while (s < end) {
+      const char *line_end = s;
+      while (line_end < end && *line_end != '\n') { ++line_end; }
+      const char *const content_end = std::find(s, line_end, '#');
+      while (s < content_end && (*s == ' ' || *s == '\t')) { ++s; }
+      const auto is_keyword = [&](const char *key, size_t n) {
+        return size_t(content_end - s) > n && std::equal(key, key + n, s) && (s[n] == ' ' || s[n] == '\t');
+      };
+      if (is_keyword("v", 1)) { func('v', s + 2, content_end); }
+      else if (is_keyword("vt", 2)) { func('t', s + 3, content_end); }
+      else if (is_keyword("vn", 2)) { func('n', s + 3, content_end); }
+      else if (is_keyword("f", 1)) { func('f', s + 2, content_end); }
+      s = line_end + 1;
+    }
+  };
+  const auto is_space = [](char c) { return c == ' ' || c == '\t' || c == '\r'; };
+  // first pass: count the elements of each chunk {v, vt, vn, triangle}
+  std::vector<std::array<unsigned int, 4>> chunk2count(num_chunk + 1, {0, 0, 0, 0});
+  parallel_for(num_chunk, [&](unsigned int i_chunk) {
+    std::array<unsigned int, 4> count = {0, 0, 0, 0};
+    for_each_line(i_chunk, [&](char kind, const char *s, const char *end) {
+      if (kind == 'v') { count[0] += 1; }
+      if (kind == 't') { count[1] += 1; }
+      if (kind == 'n') { count[2] += 1; }
+      if (kind != 'f') { return; }
+      unsigned int num_corner = 0;
+      for (bool is_prev_space = true; s < end; ++s) {
+        if (!is_space(*s) && is_prev_space) { num_corner += 1; }
+        is_prev_space = is_space(*s);
+      }
+      if (num_corner >= 3) { count[3] += num_corner - 2; }
+    });
+    chunk2count[i_chunk + 1] = count;
+  }, num_thread);
+  for (unsigned int i_chunk = 0; i_chunk < num_chunk; ++i_chunk) {
+    for (unsigned int i = 0; i < 4; ++i) { chunk2count[i_chunk + 1][i] += chunk2count[i_chunk][i]; }
+  }
+  const std::array<unsigned int, 4> &total = chunk2count[num_chunk];
+  WavefrontObj obj;
+  obj.vtx2xyz.resize(total[0] * 3);
+  obj.vtx2uv.resize(total[1] * 2);
+  obj.vtx2nrm.resize(total[2] * 3);
+  obj.tri2vtx.resize(total[3] * 3);
+  obj.tri2uv.resize(total[3] * 3);
+  obj.tri2nrm.resize(total[3] * 3);
+  // second pass: parse the chunks in parallel
+  std::vector<unsigned char> chunk2error(num_chunk, 0);
+  parallel_for(num_chunk, [&](unsigned int i_chunk) {
+    std::array<unsigned int, 4> count = chunk2count[i_chunk]; // elements before the current line
+    const auto read_floats = [&](const char *s, const char *end, float *values, unsigned int num) {
+      for (unsigned int i = 0; i < num; ++i) {
+        while (s < end && is_space(*s)) { ++s; }
+        if (s < end && *s == '+') { ++s; } // from_chars does not accept the plus sign
+        const auto[ptr, ec] = std::from_chars(s, end, values[i]);
+        if (ec != std::errc()) { values[i] = 0.f; } // e.g., "vt u" without v
+        s = ptr;
+      }
+    };
+    // 1-based index, or negative index relative to the end of the elements defined so far
+    const auto read_index = [&](const char *&s, const char *end, unsigned int num_before) {
+      int i = 0;
+      const auto[ptr, ec] = std::from_chars(s, end, i);
+      if (ec != std::errc()) { return UINT_MAX; }
+      s = ptr;
+      if (i > 0) { return static_cast<unsigned int>(i - 1); }
+      if (i < 0 && static_cast<unsigned int>(-i) <= num_before) { return num_before - static_cast<unsigned int>(-i); }
+      chunk2error[i_chunk] = 1;
+      return UINT_MAX;
+    };
+    for_each_line(i_chunk, [&](char kind, const char *s, const char *end) {
+      if (kind == 'v') { read_floats(s, end, obj.vtx2xyz.data() + count[0]++ * 3, 3); }
+      if (kind == 't') { read_floats(s, end, obj.vtx2uv.data() + count[1]++ * 2, 2); }
+      if (kind == 'n') { read_floats(s, end, obj.vtx2nrm.data() + count[2]++ * 3, 3); }
+      if (kind != 'f') { return; }
+      std::array<unsigned int, 3> first{}, prev{}; // corners {v, vt, vn} of the fan
+      for (unsigned int i_corner = 0; s < end; ++i_corner) {
+        while (s < end && is_space(*s)) { ++s; }
+        if (s == end) { break; }
+        std::array<unsigned int, 3> cur = {read_index(s, end, count[0]), UINT_MAX, UINT_MAX};
+        if (s < end && *s == '/') {
+          ++s;
+          if (s < end && *s != '/' && !is_space(*s)) { cur[1] = read_index(s, end, count[1]); }
+          if (s < end && *s == '/') {
+            ++s;
+            if (s < end && !is_space(*s)) { cur[2] = read_index(s, end, count[2]); }
+          }
+        }
+        while (s < end && !is_space(*s)) { ++s; } // skip anything unexpected in the corner
+        if (cur[0] == UINT_MAX) { chunk2error[i_chunk] = 1; }
+        if (i_corner >= 2) {
+          const unsigned int i_tri = count[3]++;
+          for (unsigned int i = 0; i < 3; ++i) {
+            unsigned int *tri2idx = i == 0 ? obj.tri2vtx.data() : (i == 1 ? obj.tri2uv.data() : obj.tri2nrm.data());
+            tri2idx[i_tri * 3 + 0] = first[i];
+            tri2idx[i_tri * 3 + 1] = prev[i];
+            tri2idx[i_tri * 3 + 2] = cur[i];
+          }
+        }
+        if (i_corner == 0) { first = cur; }
+        prev = cur;
+      }
+    });
+    for (unsigned int i = chunk2count[i_chunk][3] * 3; i < count[3] * 3; ++i) { // indices beyond the end
+      if (obj.tri2vtx[i] >= total[0]) { chunk2error[i_chunk] = 1; }
+      if (obj.tri2uv[i] != UINT_MAX && obj.tri2uv[i] >= total[1]) { chunk2error[i_chunk] = 1; }
+      if (obj.tri2nrm[i] != UINT_MAX && obj.tri2nrm[i] >= total[2]) { chunk2error[i_chunk] = 1; }
+    }
+  }, num_thread);
+  for (unsigned char error: chunk2error) { if (error) { return std::nullopt; } }
+  return obj;
+}
+
+/**
+ * load the positions and the triangles of the Wavefront OBJ file (see `read_wavefrontobj`)
+ * @return 3xN matrix of the vertex indices of the triangles, 3xN matrix of the vertex coordinates
+ */
 auto read_wavefrontobj_as_3d_triangle_mesh(
     const char* file_path)
 -> std::tuple<Eigen::Matrix<unsigned int, 3, Eigen::Dynamic>, Eigen::Matrix3Xf> {
   using myMatrix3Xui = Eigen::Matrix<unsigned int, 3, Eigen::Dynamic>;
-  std::ifstream fin;
-  fin.open(file_path);
-  if (fin.fail()) {
+  const std::optional<WavefrontObj> obj = read_wavefrontobj(file_path);
+  if (!obj) {
     std::cout << "File Read Fail" << std::endl;
     Eigen::Matrix<unsigned int, 3, Eigen::Dynamic> b;
     Eigen::Matrix3Xf a;
     return std::make_tuple(b, a);
   }
-  std::vector<float> vtx2xyz;
-  std::vector<unsigned int> tri2vtx;
-  constexpr unsigned int BUFF_SIZE = 256;
-  char buff[BUFF_SIZE];
-  while (fin.getline(buff, BUFF_SIZE)) {
-    if (buff[0] == '#') { continue; }
-    if (buff[0] == 'v' && buff[1] == ' ') {
-      char str[256];
-      float x, y, z;
-      std::istringstream is(buff);
-      is >> str >> x >> y >> z;
-      vtx2xyz.push_back(x);
-      vtx2xyz.push_back(y);
-      vtx2xyz.push_back(z);
+  Eigen::Matrix3Xf a = Eigen::Map<const Eigen::Matrix3Xf>(obj->vtx2xyz.data(), 3, obj->vtx2xyz.size() / 3);
+  myMatrix3Xui b = Eigen::Map<const myMatrix3Xui>(obj->tri2vtx.data(), 3, obj->tri2vtx.size() / 3);
+  return std::make_tuple(b, a);
+}
+
+/**
+ * corners of the triangles around each vertex in the compressed sparse row format.
+ * The adjacency depends only on the connectivity, so it can be reused while the vertices move.
+ * @param num_vtx number of the vertices
+ * @return vtx2idx and idx2corner. The corners around the i-th vertex are idx2corner[vtx2idx[i]:vtx2idx[i+1]],
+ * where the corner `c` is the (c%3)-th corner of the (c/3)-th triangle
+ */
+inline auto vtx2corner_of_triangle_mesh(
+    const Eigen::Ref<const Eigen::Matrix<unsigned int, 3, Eigen::Dynamic>> &tri2vtx,
+    unsigned int num_vtx) -> std::pair<std::vector<unsigned int>, std::vector<unsigned int>> {
+  const auto num_corner = static_cast<unsigned int>(tri2vtx.size());
+  std::vector<unsigned int> vtx2idx(num_vtx + 1, 0);
+  for (unsigned int i_corner = 0; i_corner < num_corner; ++i_corner) { vtx2idx[tri2vtx.data()[i_corner] + 1] += 1; }
+  for (unsigned int i_vtx = 0; i_vtx < num_vtx; ++i_vtx) { vtx2idx[i_vtx + 1] += vtx2idx[i_vtx]; }
+  std::vector<unsigned int> idx2corner(num_corner);
+  std::vector<unsigned int> vtx2fill(vtx2idx.begin(), vtx2idx.end() - 1);
+  for (unsigned int i_corner = 0; i_corner < num_corner; ++i_corner) {
+    idx2corner[vtx2fill[tri2vtx.data()[i_corner]]++] = i_corner;
+  }
+  return {vtx2idx, idx2corner};
+}
+
+/**
+ * weight of the normals of the triangles around a vertex
+ */
+enum class NormalWeight {
+  Uniform, // same weight for all the triangles
+  Area, // area of the triangle
+  Angle, // angle of the triangle at the vertex
+};
+
+/**
+ * compute the normals at the vertices without the race between the threads.
+ * The normals of the triangles are computed in parallel first, and then each vertex gathers the normals of
+ * the triangles around it in parallel. The normals are stored with a padding (4 floats per triangle),
+ * so a triangle normal is added as one SIMD packet.
+ * @param vtx2nrm (out) normals of the vertices. A vertex without a triangle has the zero vector
+ * @param vtx2idx adjacency from the vertices to the corners (see `vtx2corner_of_triangle_mesh`)
+ * @param num_thread number of threads (0: use all the hardware threads)
+ */
+inline void vertex_normals_of_triangle_mesh(
+    Eigen::Matrix3Xf &vtx2nrm,
+    const Eigen::Ref<const Eigen::Matrix<unsigned int, 3, Eigen::Dynamic>> &tri2vtx,
+    const Eigen::Ref<const Eigen::Matrix3Xf> &vtx2xyz,
+    const std::vector<unsigned int> &vtx2idx,
+    const std::vector<unsigned int> &idx2corner,
+    NormalWeight weight,
+    unsigned int num_thread = 0) {
+  const auto num_tri = static_cast<unsigned int>(tri2vtx.cols());
+  const auto num_vtx = static_cast<unsigned int>(vtx2xyz.cols());
+  Eigen::Matrix4Xf tri2nrm(4, num_tri); // normal of the triangle weighted for the uniform or area weight
+  Eigen::Matrix3Xf tri2angle(3, weight == NormalWeight::Angle ? num_tri : 0); // angles at the corners
+  parallel_for(num_tri, [&](unsigned int i_tri) {
+    const Eigen::Vector3f p0 = vtx2xyz.col(tri2vtx(0, i_tri));
+    const Eigen::Vector3f p1 = vtx2xyz.col(tri2vtx(1, i_tri));
+    const Eigen::Vector3f p2 = vtx2xyz.col(tri2vtx(2, i_tri));
+    Eigen::Vector3f n = (p1 - p0).cross(p2 - p0); // length is twice the area
+    const float len = n.norm();
+    if (weight != NormalWeight::Area) { n = len > 0.f ? Eigen::Vector3f(n / len) : Eigen::Vector3f::Zero(); }
+    tri2nrm.col(i_tri).head<3>() = n;
+    tri2nrm(3, i_tri) = 0.f;
+    if (weight != NormalWeight::Angle) { return; }
+    const std::array<Eigen::Vector3f, 3> p = {p0, p1, p2};
+    for (unsigned int i_node = 0; i_node < 3; ++i_node) {
+      const Eigen::Vector3f e1 = p[(i_node + 1) % 3] - p[i_node];
+      const Eigen::Vector3f e2 = p[(i_node + 2) % 3] - p[i_node];
+      tri2angle(i_node, i_tri) = std::atan2(e1.cross(e2).norm(), e1.dot(e2));
     }
-    if (buff[0] == 'f') {
-      std::vector<std::string> vec_str;
-      {
-        std::istringstream iss(buff);
-        std::string s;
-        bool is_init = true;
-        while (iss >> s) {
-          if (is_init) {
-            is_init = false;
-            continue;
-          }
-          vec_str.push_back(s);
-        }
-      }
-      std::vector<int> aI;
-      aI.reserve(4);
-      for (auto str: vec_str) {
-        for (char &i: str) {
-          if (i == '/') {
-            i = '\0';
-            break;
-          }
-        }
-        int i0 = std::stoi(str);
-        aI.push_back(i0 - 1);
-      }
-      if (aI.size() == 3) {
-        tri2vtx.push_back(aI[0]);
-        tri2vtx.push_back(aI[1]);
-        tri2vtx.push_back(aI[2]);
-      }
-      if (aI.size() == 4) {
-        tri2vtx.push_back(aI[0]);
-        tri2vtx.push_back(aI[1]);
-        tri2vtx.push_back(aI[2]);
-        //
-        tri2vtx.push_back(aI[0]);
-        tri2vtx.push_back(aI[2]);
-        tri2vtx.push_back(aI[3]);
+  }, num_thread);
+  vtx2nrm.resize(3, num_vtx);
+  parallel_for(num_vtx, [&](unsigned int i_vtx) {
+    Eigen::Vector4f n = Eigen::Vector4f::Zero();
+    for (unsigned int idx = vtx2idx[i_vtx]; idx < vtx2idx[i_vtx + 1]; ++idx) {
+      const unsigned int i_tri = idx2corner[idx] / 3;
+      if (weight == NormalWeight::Angle) {
+        n += tri2nrm.col(i_tri) * tri2angle(idx2corner[idx] % 3, i_tri);
+      } else {
+        n += tri2nrm.col(i_tri);
       }
     }
-  }
-  Eigen::Matrix3Xf a = Eigen::Map<Eigen::Matrix3Xf, Eigen::Unaligned>(vtx2xyz.data(), 3, vtx2xyz.size() / 3);
-  myMatrix3Xui b = Eigen::Map<myMatrix3Xui, Eigen::Unaligned>(tri2vtx.data(), 3, tri2vtx.size() / 3);
-  return std::make_tuple(b, a);
+    const float len = n.norm();
+    vtx2nrm.col(i_vtx) = len > 0.f ? Eigen::Vector3f(n.head<3>() / len) : Eigen::Vector3f::Zero();
+  }, num_thread);
 }
 
-auto vertex_normals_of_triangle_mesh(
-    const Eigen::Matrix<unsigned int, 3, Eigen::Dynamic> &tri2vtx,
-    const Eigen::Matrix3Xf &vtx2xyz) -> Eigen::Matrix3Xf {
-  const auto num_vtx = vtx2xyz.size() / 3;
-  auto vtx2normal = std::vector<float>(num_vtx * 3, 0.f);
-  for (unsigned int i_tri = 0; i_tri < tri2vtx.cols(); ++i_tri) {
-    const unsigned int i0 = tri2vtx(0, i_tri);
-    const unsigned int i1 = tri2vtx(1, i_tri);
-    const unsigned int i2 = tri2vtx(2, i_tri);
-    auto p0 = vtx2xyz.col(i0);
-    auto p1 = vtx2xyz.col(i1);
-    auto p2 = vtx2xyz.col(i2);
-    Eigen::Vector3f un = (p1 - p0).cross(p2 - p0).normalized();
-    for (int i_dim = 0; i_dim < 3; ++i_dim) {
-      vtx2normal[i0 * 3 + i_dim] += un[i_dim];
-      vtx2normal[i1 * 3 + i_dim] += un[i_dim];
-      vtx2normal[i2 * 3 + i_dim] += un[i_dim];
-    }
-  }
-  for (int i_vtx=0;i_vtx<num_vtx;++i_vtx){
-    auto n = Eigen::Map<Eigen::Vector3f, Eigen::Unaligned>(vtx2normal.data() + i_vtx*3);
-    n.normalize();
-  }
-  return Eigen::Map<Eigen::Matrix3Xf, Eigen::Unaligned>(vtx2normal.data(), 3, num_vtx);
+/**
+ * compute the normals at the vertices as the sum of the unit normals of the triangles around them
+ * @return normals of the vertices
+ */
+inline auto vertex_normals_of_triangle_mesh(
+    const Eigen::Ref<const Eigen::Matrix<unsigned int, 3, Eigen::Dynamic>> &tri2vtx,
+    const Eigen::Ref<const Eigen::Matrix3Xf> &vtx2xyz) -> Eigen::Matrix3Xf {
+  const auto[vtx2idx, idx2corner] = vtx2corner_of_triangle_mesh(tri2vtx, static_cast<unsigned int>(vtx2xyz.cols()));
+  Eigen::Matrix3Xf vtx2nrm;
+  vertex_normals_of_triangle_mesh(vtx2nrm, tri2vtx, vtx2xyz, vtx2idx, idx2corner, NormalWeight::Uniform);
+  return vtx2nrm;
 }
 
 } // namespace acg
@@ -3,11 +3,19 @@
 #include <cassert>
 #include <vector>
 #include <filesystem>
+#include <algorithm>
+#include <cstdint>
+#include <chrono>
+#include <random>
+#include <string>
 #define _USE_MATH_DEFINES
 #include <cmath>
 //
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #include "stb_image_write.h"
+//
+#include "rasterize_line.h"
+#include "tile_scheduler.h"
 
 /**
  * @brief compute the area of a triangle
@@ -21,63 +29,166 @@ float area_of_a_triangle(
 }
 
 /**
- * @brief draw a triangle using the barycentric coordinates
+ * @brief draw a triangle evaluating the edge functions incrementally in its bounding box
+ * @details The corners are snapped to the fixed-point grid with 1/256 pixel precision and the edge functions
+ * are evaluated in integer. A pixel center exactly on an edge is painted only if the edge is a top or left edge,
+ * so two triangles sharing an edge never paint the same pixel twice. Eight pixels are processed in one step.
+ * @param brightness brightness of the painted pixel
+ * @param clip only the pixels in this rectangle are painted
  */
 void draw_triangle(
     float x0, float y0,
     float x1, float y1,
     float x2, float y2,
     std::vector<unsigned char> &img_data, unsigned int width, unsigned int height,
-    unsigned char brightness) {
-  for (unsigned int ih = 0; ih < height; ++ih) {
-    for (unsigned int iw = 0; iw < width; ++iw) {
-      const auto x = (float) iw + 0.5f;
-      const auto y = (float) ih + 0.5f;
-      const auto a01 = area_of_a_triangle(x, y, x0, y0, x1, y1);
-      const auto a12 = area_of_a_triangle(x, y, x1, y1, x2, y2);
-      const auto a20 = area_of_a_triangle(x, y, x2, y2, x0, y0);
-      if (a01 > 0.f && a12 > 0.f && a20 > 0.f) {
-        img_data[ih * height + iw] = brightness;
+    unsigned char brightness,
+    const acg::PixelRect &clip = acg::PixelRect()) {
+  if (area_of_a_triangle(x0, y0, x1, y1, x2, y2) <= 0.f) { return; } // clockwise or degenerate triangle
+  constexpr int64_t num_subpixel = 256; // precision of the fixed-point coordinate
+  const int64_t px[3] = {
+      std::llround(x0 * num_subpixel), std::llround(x1 * num_subpixel), std::llround(x2 * num_subpixel)};
+  const int64_t py[3] = {
+      std::llround(y0 * num_subpixel), std::llround(y1 * num_subpixel), std::llround(y2 * num_subpixel)};
+  // range of the pixels whose center is inside the bounding box of the triangle
+  const int64_t half = num_subpixel / 2;
+  const int64_t xmin = std::min({px[0], px[1], px[2]}), xmax = std::max({px[0], px[1], px[2]});
+  const int64_t ymin = std::min({py[0], py[1], py[2]}), ymax = std::max({py[0], py[1], py[2]});
+  const auto floor_div = [](int64_t a, int64_t b) { return a >= 0 ? a / b : -((-a + b - 1) / b); };
+  const int64_t iw_max = int64_t(std::min(width, clip.iw_end)) - 1;
+  const int64_t ih_max = int64_t(std::min(height, clip.ih_end)) - 1;
+  const int iw_start = int(std::max<int64_t>(clip.iw_begin, floor_div(xmin - half + num_subpixel - 1, num_subpixel)));
+  const int iw_end = int(std::min<int64_t>(iw_max, floor_div(xmax - half, num_subpixel)));
+  const int ih_start = int(std::max<int64_t>(clip.ih_begin, floor_div(ymin - half + num_subpixel - 1, num_subpixel)));
+  const int ih_end = int(std::min<int64_t>(ih_max, floor_div(ymax - half, num_subpixel)));
+  if (iw_start > iw_end || ih_start > ih_end) { return; }
+  // edge function E(x,y) = a*x + b*y + c of the edge (i0, i1). It is the same as 2 * area_of_a_triangle(x, y, p0, p1)
+  int64_t step_x[3], step_y[3], e_row[3];
+  for (int i_edge = 0; i_edge < 3; ++i_edge) {
+    const int i0 = i_edge;
+    const int i1 = (i_edge + 1) % 3;
+    const int64_t a = py[i1] - py[i0];
+    const int64_t b = px[i0] - px[i1];
+    const int64_t c = px[i1] * py[i0] - px[i0] * py[i1];
+    const bool is_top_left = a > 0 || (a == 0 && b > 0); // the interior is on the right or below the edge
+    step_x[i_edge] = a * num_subpixel;
+    step_y[i_edge] = b * num_subpixel;
+    e_row[i_edge] = a * (iw_start * num_subpixel + half) + b * (ih_start * num_subpixel + half) + c
+        + (is_top_left ? 0 : -1); // E >= 0 on the top-left edges, E > 0 on the others
+  }
+  constexpr int num_lane = 8;
+  for (int ih = ih_start; ih <= ih_end; ++ih) {
+    unsigned char *row = img_data.data() + ih * width;
+    int64_t e0 = e_row[0], e1 = e_row[1], e2 = e_row[2];
+    for (int iw = iw_start; iw <= iw_end; iw += num_lane) {
+      const int num_valid = std::min(num_lane, iw_end - iw + 1);
+      bool is_inside[num_lane];
+      for (int k = 0; k < num_lane; ++k) { // all the edge functions are non-negative
+        is_inside[k] = ((e0 + k * step_x[0]) | (e1 + k * step_x[1]) | (e2 + k * step_x[2])) >= 0;
       }
+      for (int k = 0; k < num_valid; ++k) {
+        row[iw + k] = is_inside[k] ? brightness : row[iw + k];
+      }
+      e0 += num_lane * step_x[0];
+      e1 += num_lane * step_x[1];
+      e2 += num_lane * step_x[2];
     }
+    e_row[0] += step_y[0];
+    e_row[1] += step_y[1];
+    e_row[2] += step_y[2];
   }
 }
 
 /**
- * @brief draw a triangle using the barycentric coordinates
+ * @brief rule to decide if a point is inside of the polygon from its winding number
+ */
+enum class FillRule {
+  NonZero, // inside if the winding number is not zero
+  EvenOdd, // inside if the winding number is odd
+};
+
+/**
+ * @brief draw a polygon with the scanline algorithm
+ * @details The edges are sorted into the edge table by the first scanline they cross. For each scanline,
+ * the active edges are kept sorted by their x-intercept that is updated incrementally, and
+ * the spans between the consecutive intercepts are painted according to the winding number.
+ * A pixel is painted if its center is inside of the polygon.
  * @param polygon_xy xy coordinates of the corners of the polygon (counter clockwise order)
  * @param brightness brightness of the painted pixel
+ * @param fill_rule rule to decide inside from the winding number
+ * @param clip only the pixels in this rectangle are painted
  */
 void draw_polygon(
     const std::vector<float> &polygon_xy,
     std::vector<unsigned char> &img_data, unsigned int width, unsigned int height,
-    unsigned int brightness) {
-  for (unsigned int ih = 0; ih < height; ++ih) {
-    for (unsigned int iw = 0; iw < width; ++iw) {
-      const auto x = float(iw) + 0.5f; // x-coordinate of the center of the pixel
-      const auto y = float(ih) + 0.5f; // y-coordinate of the center of the pixel
-      const unsigned int num_vtx = polygon_xy.size() / 2;
-      float winding_number = 0.0;
-      for (unsigned int iedge = 0; iedge < num_vtx; ++iedge) {
-        unsigned int i0_vtx = iedge;
-        unsigned int i1_vtx = (iedge + 1) % num_vtx;
-        // positions of the end points of the edge relative to (x,y)
-        float p0x = polygon_xy[i0_vtx * 2 + 0] - x;
-        float p0y = polygon_xy[i0_vtx * 2 + 1] - y;
-        float p1x = polygon_xy[i1_vtx * 2 + 0] - x;
-        float p1y = polygon_xy[i1_vtx * 2 + 1] - y;
-        // write a few lines of code to compute winding number (hint: use atan2)
-      }
-      const int int_winding_number = int(std::round(winding_number));
-      if (int_winding_number == 1 ) { // if (x,y) is inside the polygon
-        img_data[ih*width + iw] = brightness;
+    unsigned int brightness,
+    FillRule fill_rule = FillRule::NonZero,
+    const acg::PixelRect &clip = acg::PixelRect()) {
+  class ScanEdge {
+   public:
+    int ih_start; // first scanline crossing the edge
+    int ih_end; // one past the last scanline crossing the edge
+    double x; // x-intercept at the current scanline
+    double dxdy; // increment of the x-intercept per scanline
+    int winding; // +1 if the edge goes downward, -1 otherwise
+  };
+  // edge table
+  const unsigned int num_vtx = polygon_xy.size() / 2;
+  std::vector<ScanEdge> edges;
+  edges.reserve(num_vtx);
+  for (unsigned int iedge = 0; iedge < num_vtx; ++iedge) {
+    const unsigned int i0_vtx = iedge;
+    const unsigned int i1_vtx = (iedge + 1) % num_vtx;
+    double x0 = polygon_xy[i0_vtx * 2 + 0], y0 = polygon_xy[i0_vtx * 2 + 1];
+    double x1 = polygon_xy[i1_vtx * 2 + 0], y1 = polygon_xy[i1_vtx * 2 + 1];
+    if (y0 == y1) { continue; } // horizontal edge does not cross any scanline
+    const int winding = y1 > y0 ? 1 : -1;
+    if (y0 > y1) {
+      std::swap(x0, x1);
+      std::swap(y0, y1);
+    }
+    // scanline `ih` (y = ih + 0.5) crosses the edge if y0 <= ih + 0.5 < y1
+    const int ih_start = std::max(int(clip.ih_begin), int(std::ceil(y0 - 0.5)));
+    const int ih_end = std::min(int(std::min(height, clip.ih_end)), int(std::ceil(y1 - 0.5)));
+    if (ih_start >= ih_end) { continue; }
+    const double dxdy = (x1 - x0) / (y1 - y0);
+    edges.push_back({ih_start, ih_end, x0 + (double(ih_start) + 0.5 - y0) * dxdy, dxdy, winding});
+  }
+  std::sort(edges.begin(), edges.end(), [](const ScanEdge &a, const ScanEdge &b) { return a.ih_start < b.ih_start; });
+  // walk the scanlines with the active edge list
+  std::vector<ScanEdge> active;
+  unsigned int i_edge_next = 0;
+  const int ih_last = int(std::min(height, clip.ih_end));
+  for (int ih = edges.empty() ? ih_last : edges[0].ih_start; ih < ih_last; ++ih) {
+    for (; i_edge_next < edges.size() && edges[i_edge_next].ih_start == ih; ++i_edge_next) {
+      active.push_back(edges[i_edge_next]);
+    }
+    active.erase(
+        std::remove_if(active.begin(), active.end(), [ih](const ScanEdge &e) { return e.ih_end <= ih; }),
+        active.end());
+    if (active.empty() && i_edge_next == edges.size()) { break; }
+    for (unsigned int i = 1; i < active.size(); ++i) { // insertion sort as the list is almost sorted
+      for (unsigned int j = i; j > 0 && active[j - 1].x > active[j].x; --j) { std::swap(active[j - 1], active[j]); }
+    }
+    int winding_number = 0;
+    for (unsigned int i = 0; i + 1 < active.size(); ++i) {
+      winding_number += active[i].winding;
+      const bool is_inside = (fill_rule == FillRule::NonZero) ? (winding_number != 0) : (winding_number % 2 != 0);
+      if (!is_inside) { continue; }
+      // paint the pixels whose center x + 0.5 is in [active[i].x, active[i+1].x)
+      const int iw_start = std::max(int(clip.iw_begin), int(std::ceil(active[i].x - 0.5)));
+      const int iw_end = std::min(int(std::min(width, clip.iw_end)), int(std::ceil(active[i + 1].x - 0.5)));
+      for (int iw = iw_start; iw < iw_end; ++iw) {
+        img_data[ih * width + iw] = brightness;
       }
     }
+    for (auto &e: active) { e.x += e.dxdy; }
   }
 }
 
 /**
  * @brief draw a line using DDA algorithm
+ * @details The end points are snapped to the pixels and the line is walked by the integer-only DDA (Bresenham).
+ * The segment is clipped to the image before walking it.
  * @param x0 x-coordinate of the first end point
  * @param y0 y-coordinate of the first end point
  * @param x1 x-coordinate of the second end point
@@ -90,12 +201,118 @@ void dda_line(
     std::vector<unsigned char> &img_data,
     unsigned int width,
     unsigned char brightness ) {
-  auto dx = x1 - x0;
-  auto dy = y1 - y0;
-  // write some code below to paint pixel on the line with color `brightness`
+  const auto height = static_cast<unsigned int>(img_data.size() / width);
+  acg::draw_line(x0, y0, x1, y1, img_data, width, height, brightness);
 }
 
-int main() {
+/**
+ * @brief draw many random segments with each line style and report the time
+ * @param num_segment number of the segments
+ */
+void benchmark_lines(unsigned int num_segment) {
+  constexpr unsigned int width = 1024;
+  constexpr unsigned int height = 1024;
+  std::mt19937 rndeng(0);
+  std::uniform_real_distribution<float> dist_pos(-64.f, float(width) + 64.f); // some go out of the image
+  std::uniform_real_distribution<float> dist_len(-32.f, 32.f);
+  std::vector<float> seg2xy(num_segment * 4);
+  for (unsigned int i_seg = 0; i_seg < num_segment; ++i_seg) {
+    seg2xy[i_seg * 4 + 0] = dist_pos(rndeng);
+    seg2xy[i_seg * 4 + 1] = dist_pos(rndeng);
+    seg2xy[i_seg * 4 + 2] = seg2xy[i_seg * 4 + 0] + dist_len(rndeng);
+    seg2xy[i_seg * 4 + 3] = seg2xy[i_seg * 4 + 1] + dist_len(rndeng);
+  }
+  const std::pair<acg::LineStyle, const char *> styles[3] = {
+      {acg::LineStyle::Bresenham, "bresenham"}, {acg::LineStyle::Wu, "wu"}, {acg::LineStyle::Thick, "thick"}};
+  std::vector<unsigned char> img_data;
+  for (const auto &[style, name]: styles) {
+    for (unsigned int num_thread: {1u, 0u}) {
+      img_data.assign(width * height, 255);
+      const auto start = std::chrono::steady_clock::now();
+      acg::draw_lines(seg2xy, style, 3.f, img_data, width, height, 0, num_thread);
+      const auto end = std::chrono::steady_clock::now();
+      const double ms = std::chrono::duration<double, std::milli>(end - start).count();
+      std::cout << name << " (" << (num_thread == 1 ? "1 thread" : "all threads") << "): " << ms << " ms, "
+                << double(num_segment) / ms * 1.0e-3 << " M segments/s" << std::endl;
+    }
+  }
+  stbi_write_png( // the last image (thick lines)
+      (std::filesystem::path(PROJECT_SOURCE_DIR) / "output.png").string().c_str(),
+      width, height, 1, img_data.data(), width);
+}
+
+/**
+ * @brief draw many random triangles and polygons tile by tile in parallel and compare with drawing them serially
+ * @param num_triangle number of the triangles
+ */
+void benchmark_tiles(unsigned int num_triangle) {
+  constexpr unsigned int width = 1024;
+  constexpr unsigned int height = 1024;
+  std::mt19937 rndeng(0);
+  std::uniform_real_distribution<float> dist_pos(0.f, float(width));
+  std::uniform_real_distribution<float> dist_size(-24.f, 24.f);
+  std::vector<float> tri2xy(num_triangle * 6);
+  for (unsigned int i_tri = 0; i_tri < num_triangle; ++i_tri) {
+    const float cx = dist_pos(rndeng), cy = dist_pos(rndeng);
+    for (unsigned int i = 0; i < 3; ++i) {
+      tri2xy[i_tri * 6 + i * 2 + 0] = cx + dist_size(rndeng);
+      tri2xy[i_tri * 6 + i * 2 + 1] = cy + dist_size(rndeng);
+    }
+    if (area_of_a_triangle(tri2xy[i_tri * 6 + 0], tri2xy[i_tri * 6 + 1], tri2xy[i_tri * 6 + 2],
+                           tri2xy[i_tri * 6 + 3], tri2xy[i_tri * 6 + 4], tri2xy[i_tri * 6 + 5]) < 0.f) {
+      std::swap(tri2xy[i_tri * 6 + 2], tri2xy[i_tri * 6 + 4]); // make it counter clockwise
+      std::swap(tri2xy[i_tri * 6 + 3], tri2xy[i_tri * 6 + 5]);
+    }
+  }
+  const std::vector<float> polygon_xy = {100., 100., 900., 150., 500., 900., 300., 300., 800., 700.}; // star-like
+  const auto draw = [&](unsigned int i_prim, std::vector<unsigned char> &img, const acg::PixelRect &clip) {
+    if (i_prim == num_triangle) { // the polygon is drawn last
+      draw_polygon(polygon_xy, img, width, height, 128, FillRule::EvenOdd, clip);
+      return;
+    }
+    const float *p = tri2xy.data() + i_prim * 6;
+    draw_triangle(p[0], p[1], p[2], p[3], p[4], p[5], img, width, height, (i_prim * 37) % 256, clip);
+  };
+  std::vector<unsigned char> img_serial(width * height, 255);
+  const auto start = std::chrono::steady_clock::now();
+  for (unsigned int i_prim = 0; i_prim <= num_triangle; ++i_prim) { draw(i_prim, img_serial, acg::PixelRect()); }
+  const auto end = std::chrono::steady_clock::now();
+  std::cout << "serial: " << std::chrono::duration<double, std::milli>(end - start).count() << " ms" << std::endl;
+  //
+  std::vector<unsigned char> img_data(width * height, 255);
+  acg::TileScheduler scheduler(width, height);
+  const auto start_tile = std::chrono::steady_clock::now();
+  scheduler.bin(num_triangle + 1, [&](unsigned int i_prim) -> std::array<float, 4> {
+    const float *p = i_prim == num_triangle ? polygon_xy.data() : tri2xy.data() + i_prim * 6;
+    const unsigned int num_vtx = i_prim == num_triangle ? polygon_xy.size() / 2 : 3;
+    std::array<float, 4> b = {p[0], p[1], p[0], p[1]};
+    for (unsigned int i_vtx = 1; i_vtx < num_vtx; ++i_vtx) {
+      b = {std::min(b[0], p[i_vtx * 2]), std::min(b[1], p[i_vtx * 2 + 1]),
+           std::max(b[2], p[i_vtx * 2]), std::max(b[3], p[i_vtx * 2 + 1])};
+    }
+    return b;
+  });
+  scheduler.run([&](const acg::Tile &tile) {
+    for (unsigned int i = 0; i < tile.num_prim; ++i) { draw(tile.prims[i], img_data, tile.rect); }
+  });
+  const auto end_tile = std::chrono::steady_clock::now();
+  std::cout << "tiled: " << std::chrono::duration<double, std::milli>(end_tile - start_tile).count() << " ms"
+            << (img_data == img_serial ? " (same as serial)" : " (DIFFERENT from serial)") << std::endl;
+  scheduler.print_statistics();
+  stbi_write_png(
+      (std::filesystem::path(PROJECT_SOURCE_DIR) / "output.png").string().c_str(),
+      width, height, 1, img_data.data(), width);
+}
+
+int main(int argc, char *argv[]) {
+  if (argc > 1 && std::string(argv[1]) == "tiles") { // draw the triangles and the polygon tile by tile
+    benchmark_tiles(argc > 2 ? std::stoi(argv[2]) : 100000);
+    return 0;
+  }
+  if (argc > 1 && std::string(argv[1]) == "lines") { // benchmark of drawing many segments
+    benchmark_lines(argc > 2 ? std::stoi(argv[2]) : 1000000);
+    return 0;
+  }
   constexpr unsigned int width = 100;
   constexpr unsigned int height = 100;
   std::vector<unsigned char> img_data(width * height, 255); // white initial image
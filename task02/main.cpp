@@ -6,6 +6,12 @@
 #include "Eigen/Core"
 //
 #include "parse_svg.h"
+#include "rasterize_coverage.h"
+#include "util_bezier.h"
+#include "curve_grid.h"
+#include "sdf_atlas.h"
+#include "tile_scheduler.h"
+#include "util_parallel.h"
 
 /***
  * signed area of a triangle connecting points (p0, p1, p2) in counter-clockwise order.
@@ -69,17 +75,125 @@ int number_of_intersection_ray_against_quadratic_bezier(
   // write some code below to find the intersection between ray and the quadratic
 }
 
-int main() {
+/***
+ * fill the inside of the closed loops (even-odd rule) one row at a time.
+ * The crossings of the horizontal line through the pixel centers are computed once per row,
+ * sorted, and the pixels between every other pair of crossings are painted.
+ * @param edges line segments and quadratic Bézier curves of the closed loops
+ * @param width image width
+ * @param height image height
+ * @param img_data grayscale image (the inside is painted black)
+ */
+void fill_edges_scanline(
+    const std::vector<acg::Edge> &edges,
+    unsigned int width,
+    unsigned int height,
+    std::vector<unsigned char> &img_data) {
+  const std::vector<acg::Edge> pieces = acg::y_monotone_pieces(edges); // each piece crosses a row at most once
+  acg::parallel_for(height, [&](unsigned int ih) {
+    const float y = float(ih) + 0.5f; // pixel center
+    std::vector<float> crossings;
+    for (const auto &piece: pieces) {
+      if ((piece.ps.y() <= y) == (piece.pe.y() <= y)) { continue; } // half-open: shared end points counted once
+      crossings.push_back(acg::x_crossing_horizontal_line(piece, y));
+    }
+    std::sort(crossings.begin(), crossings.end());
+    for (unsigned int i = 0; i + 1 < crossings.size(); i += 2) { // spans between odd and even crossings are inside
+      // paint the pixels whose centers are in [x0, x1)
+      const float x0 = std::clamp(std::ceil(crossings[i] - 0.5f), 0.f, float(width));
+      const float x1 = std::clamp(std::ceil(crossings[i + 1] - 0.5f), 0.f, float(width));
+      for (auto iw = static_cast<unsigned int>(x0); iw < static_cast<unsigned int>(x1); ++iw) {
+        img_data[ih * width + iw] = 0;
+      }
+    }
+  });
+}
+
+int main(int argc, char *argv[]) {
   const auto input_file_path = std::filesystem::path(PROJECT_SOURCE_DIR) / ".." / "asset" / "r.svg";
-  const auto [width, height, shape] = acg::svg_get_image_size_and_shape(input_file_path);
-  if (width == 0) { // something went wrong in loading the function
+  const std::optional<acg::SvgOutline> outline = acg::svg_read_outline(input_file_path);
+  if (!outline || outline->width == 0) { // something went wrong in loading the function
     std::cout << "file open failure" << std::endl;
     abort();
   }
-  const std::vector<std::string> outline_path = acg::svg_outline_path_from_shape(shape);
-  const std::vector<std::vector<acg::Edge>> loops = acg::svg_loops_from_outline_path(outline_path);
+  const unsigned int width = outline->width;
+  const unsigned int height = outline->height;
+  const std::vector<std::vector<acg::Edge>> loops = outline->loops();
   //
   std::vector<unsigned char> img_data(width * height, 255); // grayscale image initialized white
+  const auto output_file_path = std::filesystem::path(PROJECT_SOURCE_DIR) / "output.png";
+  if (argc > 1 && std::string(argv[1]) == "coverage") { // anti-aliased image from the exact area coverage
+    acg::CoverageRasterizer rasterizer(width, height);
+    rasterizer.add_edges(outline->edges);
+    const std::vector<float> pix2coverage = rasterizer.coverage(true);
+    for (unsigned int i_pix = 0; i_pix < width * height; ++i_pix) {
+      img_data[i_pix] = static_cast<unsigned char>(std::lround((1.f - pix2coverage[i_pix]) * 255.f));
+    }
+    stbi_write_png(output_file_path.string().c_str(), width, height, 1, img_data.data(), width);
+    return 0;
+  }
+  if (argc > 1 && std::string(argv[1]) == "scanline") { // crossings computed once per row instead of per pixel
+    fill_edges_scanline(outline->edges, width, height, img_data);
+    stbi_write_png(output_file_path.string().c_str(), width, height, 1, img_data.data(), width);
+    return 0;
+  }
+  if (argc > 1 && std::string(argv[1]) == "grid") { // per-pixel query against the pieces in the pixel's cell only
+    const acg::CurveGrid grid(outline->edges);
+    acg::parallel_for(height, [&](unsigned int ih) {
+      for (unsigned int iw = 0; iw < width; ++iw) {
+        if (grid.is_inside(Eigen::Vector2f(iw + 0.5, ih + 0.5))) { img_data[ih * width + iw] = 0; }
+      }
+    });
+    stbi_write_png(output_file_path.string().c_str(), width, height, 1, img_data.data(), width);
+    return 0;
+  }
+  if (argc > 1 && std::string(argv[1]) == "tiles") { // crossing count per pixel, tile by tile in parallel
+    const std::vector<acg::Edge> pieces = acg::y_monotone_pieces(outline->edges);
+    acg::TileScheduler scheduler(width, height);
+    // the ray goes to +x, so a piece can be crossed from the tiles on its left
+    scheduler.bin(pieces.size(), [&](unsigned int i_piece) -> std::array<float, 4> {
+      const acg::Edge &e = pieces[i_piece];
+      return {0.f, std::min(e.ps.y(), e.pe.y()), std::max({e.ps.x(), e.pc.x(), e.pe.x()}), std::max(e.ps.y(), e.pe.y())};
+    });
+    scheduler.run([&](const acg::Tile &tile) {
+      for (unsigned int ih = tile.rect.ih_begin; ih < tile.rect.ih_end; ++ih) {
+        const float y = float(ih) + 0.5f;
+        for (unsigned int iw = tile.rect.iw_begin; iw < tile.rect.iw_end; ++iw) {
+          const float x = float(iw) + 0.5f;
+          int count_cross = 0;
+          for (unsigned int i = 0; i < tile.num_prim; ++i) {
+            const acg::Edge &piece = pieces[tile.prims[i]];
+            if ((piece.ps.y() <= y) == (piece.pe.y() <= y)) { continue; }
+            if (acg::x_crossing_horizontal_line(piece, y) >= x) { count_cross += 1; }
+          }
+          if (count_cross % 2 == 1) { img_data[ih * width + iw] = 0; }
+        }
+      }
+    });
+    scheduler.print_statistics();
+    stbi_write_png(output_file_path.string().c_str(), width, height, 1, img_data.data(), width);
+    return 0;
+  }
+  if (argc > 1 && std::string(argv[1]) == "sdf") { // render at any scale from a coarse distance field
+    const float scale = argc > 2 ? std::stof(argv[2]) : 1.f;
+    acg::SdfAtlas atlas(256);
+    const std::optional<unsigned int> i_entry = atlas.add_shape(outline->edges, outline->loop2idx, 8.f); // 8 pixels per texel
+    if (!i_entry) {
+      std::cout << "the shape is wider than the atlas" << std::endl;
+      return 1;
+    }
+    const auto atlas_file_path = std::filesystem::path(PROJECT_SOURCE_DIR) / "sdf_atlas.png";
+    stbi_write_png(atlas_file_path.string().c_str(), atlas.width, atlas.height, 3, atlas.texels.data(), atlas.width * 3);
+    const auto img_width = static_cast<unsigned int>(float(width) * scale);
+    const auto img_height = static_cast<unsigned int>(float(height) * scale);
+    const std::vector<float> pix2coverage = atlas.render_coverage(*i_entry, img_width, img_height, scale);
+    std::vector<unsigned char> img(img_width * img_height);
+    for (unsigned int i_pix = 0; i_pix < img_width * img_height; ++i_pix) {
+      img[i_pix] = static_cast<unsigned char>(std::lround((1.f - pix2coverage[i_pix]) * 255.f));
+    }
+    stbi_write_png(output_file_path.string().c_str(), img_width, img_height, 1, img.data(), img_width);
+    return 0;
+  }
   for (unsigned int ih = 0; ih < height; ++ih) {
     for (unsigned int iw = 0; iw < width; ++iw) {
       const auto org = Eigen::Vector2f(iw + 0.5, ih + 0.5); // pixel center
@@ -103,6 +217,5 @@ int main() {
       }
     }
   }
-  const auto output_file_path = std::filesystem::path(PROJECT_SOURCE_DIR) / "output.png";
   stbi_write_png(output_file_path.string().c_str(), width, height, 1, img_data.data(), width);
 }
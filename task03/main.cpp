@@ -3,6 +3,9 @@
 #include <filesystem>
 // #include <experimental/filesystem> // uncomment here if the <filesystem> cannot be included above
 #include <vector>
+#include <array>
+#include <string>
+#include <algorithm>
 //
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #include "stb_image_write.h"
@@ -10,6 +13,15 @@
 #include "stb_image.h"
 #include "Eigen/Core"
 #include "Eigen/Geometry"
+//
+#include "tile_scheduler.h"
+#include "mipmap_texture.h"
+#include "clip_triangle.h"
+#include "rasterize_mesh.h"
+#include "util_triangle_mesh.h"
+#include "mesh_binary.h"
+#include "mesh_conditioning.h"
+#include "mesh_simplify.h"
 
 
 /**
@@ -32,11 +44,113 @@ Eigen::Matrix4f camera_transformation() {
 }
 
 /**
- * draw one 3D triangle with texture
+ * draw one triangle with texture that is in front of the camera and in the guard band
+ * @details The setup runs once per triangle: the corners are projected to the screen, and the edge functions and
+ * the planes of 1/w, u/w and v/w on the screen are computed. These quantities are linear on the screen while
+ * the uv coordinate is not, so they are interpolated incrementally inside the bounding box, and the
+ * perspective-correct uv coordinate costs one reciprocal per pixel.
+ * The screen-space derivatives of the uv coordinate are obtained from the same planes to select the level of the mipmap.
+ * @param q0 homogeneous coordinate of 3D point 0
+ * @param uv0 uv coordinate of point 0
+ * @param img_data_out output image data
+ * @param tex texture
+ * @param filter filter used to sample the texture
+ * @param clip only the pixels in this rectangle are drawn
+ */
+void draw_projected_triangle_with_texture(
+    const Eigen::Vector4f &q0,
+    const Eigen::Vector4f &q1,
+    const Eigen::Vector4f &q2,
+    const Eigen::Vector2f &uv0,
+    const Eigen::Vector2f &uv1,
+    const Eigen::Vector2f &uv2,
+    unsigned int width_out,
+    unsigned int height_out,
+    std::vector<unsigned char> &img_data_out,
+    const acg::MipmapTexture &tex,
+    acg::TextureFilter filter,
+    const acg::PixelRect &clip = acg::PixelRect()) {
+  const Eigen::Vector2f r[3] = { // coordinate of the corners in the normalized device coordinate [-1,1]^2
+      q0.hnormalized().head<2>(), q1.hnormalized().head<2>(), q2.hnormalized().head<2>()};
+  const auto cross = [](const Eigen::Vector2f &a, const Eigen::Vector2f &b) { return a.x() * b.y() - a.y() * b.x(); };
+  const float area = cross(r[1] - r[0], r[2] - r[0]);
+  if (area <= 0.f) { return; } // back facing or degenerate
+  // range of the pixels whose center is inside the bounding box
+  const float xmin = std::min({r[0].x(), r[1].x(), r[2].x()}), xmax = std::max({r[0].x(), r[1].x(), r[2].x()});
+  const float ymin = std::min({r[0].y(), r[1].y(), r[2].y()}), ymax = std::max({r[0].y(), r[1].y(), r[2].y()});
+  const float iw_first = std::ceil((xmin + 1.f) * 0.5f * float(width_out) - 0.5f);
+  const float iw_last = std::floor((xmax + 1.f) * 0.5f * float(width_out) - 0.5f);
+  const float ih_first = std::ceil((1.f - ymax) * 0.5f * float(height_out) - 0.5f);
+  const float ih_last = std::floor((1.f - ymin) * 0.5f * float(height_out) - 0.5f);
+  const auto iw_begin = static_cast<unsigned int>(std::max(float(clip.iw_begin), iw_first));
+  const auto ih_begin = static_cast<unsigned int>(std::max(float(clip.ih_begin), ih_first));
+  const auto iw_end = static_cast<unsigned int>(std::clamp(iw_last + 1.f, 0.f, float(std::min(width_out, clip.iw_end))));
+  const auto ih_end = static_cast<unsigned int>(std::clamp(ih_last + 1.f, 0.f, float(std::min(height_out, clip.ih_end))));
+  if (iw_begin >= iw_end || ih_begin >= ih_end) { return; }
+  // linear function f(s) = a * s.x + b * s.y + c on the screen evaluated at the pixels as f[ih][iw] = f00 + dw * iw + dh * ih
+  class Plane {
+   public:
+    float f00, dw, dh;
+  };
+  const auto to_plane = [&](float a, float b, float c) {
+    return Plane{a * (0.5f * 2.f / float(width_out) - 1.f) + b * (1.f - 0.5f * 2.f / float(height_out)) + c,
+                 a * 2.f / float(width_out), -b * 2.f / float(height_out)};
+  };
+  Plane edge[3]; // edge[i] is the area of the triangle connecting the pixel and the edge opposite to the corner i
+  for (unsigned int i = 0; i < 3; ++i) {
+    const Eigen::Vector2f &ra = r[(i + 1) % 3];
+    const Eigen::Vector2f &rb = r[(i + 2) % 3];
+    // cross(ra - s, rb - s) = cross(ra, rb) + cross(s, ra - rb)
+    edge[i] = to_plane(ra.y() - rb.y(), rb.x() - ra.x(), cross(ra, rb));
+  }
+  // planes of the quantities linear on the screen, interpolated by the barycentric coordinate on the screen
+  const auto attribute_plane = [&](float f0, float f1, float f2) {
+    return Plane{(edge[0].f00 * f0 + edge[1].f00 * f1 + edge[2].f00 * f2) / area,
+                 (edge[0].dw * f0 + edge[1].dw * f1 + edge[2].dw * f2) / area,
+                 (edge[0].dh * f0 + edge[1].dh * f1 + edge[2].dh * f2) / area};
+  };
+  const float inv_w[3] = {1.f / q0.w(), 1.f / q1.w(), 1.f / q2.w()};
+  const Plane plane_inv_w = attribute_plane(inv_w[0], inv_w[1], inv_w[2]);
+  const Plane plane_u_w = attribute_plane(uv0[0] * inv_w[0], uv1[0] * inv_w[1], uv2[0] * inv_w[2]);
+  const Plane plane_v_w = attribute_plane(uv0[1] * inv_w[0], uv1[1] * inv_w[1], uv2[1] * inv_w[2]);
+  const auto at = [&](const Plane &f, unsigned int iw, unsigned int ih) { return f.f00 + f.dw * float(iw) + f.dh * float(ih); };
+  for (unsigned int ih = ih_begin; ih < ih_end; ++ih) {
+    float e0 = at(edge[0], iw_begin, ih), e1 = at(edge[1], iw_begin, ih), e2 = at(edge[2], iw_begin, ih);
+    float iw_w = at(plane_inv_w, iw_begin, ih), u_w = at(plane_u_w, iw_begin, ih), v_w = at(plane_v_w, iw_begin, ih);
+    for (unsigned int iw = iw_begin; iw < iw_end; ++iw) {
+      if (e0 >= 0.f && e1 >= 0.f && e2 >= 0.f) { // the pixel is inside the triangle
+        const float w = 1.f / iw_w;
+        const Eigen::Vector2f uv(u_w * w, v_w * w); // uv coordinate of the pixel
+        // derivative of u = (u/w) / (1/w) is (d(u/w) - u * d(1/w)) * w
+        const float dudx = (plane_u_w.dw - uv[0] * plane_inv_w.dw) * w;
+        const float dvdx = (plane_v_w.dw - uv[1] * plane_inv_w.dw) * w;
+        const float dudy = (plane_u_w.dh - uv[0] * plane_inv_w.dh) * w;
+        const float dvdy = (plane_v_w.dh - uv[1] * plane_inv_w.dh) * w;
+        const std::array<float, 4> c = tex.sample(uv[0], uv[1], dudx, dvdx, dudy, dvdy, filter);
+        // write to the output image
+        for (unsigned int i = 0; i < 3; ++i) {
+          img_data_out[(ih * width_out + iw) * 3 + i] = static_cast<unsigned char>(std::clamp(c[i] + 0.5f, 0.f, 255.f));
+        }
+      }
+      e0 += edge[0].dw;
+      e1 += edge[1].dw;
+      e2 += edge[2].dw;
+      iw_w += plane_inv_w.dw;
+      u_w += plane_u_w.dw;
+      v_w += plane_v_w.dw;
+    }
+  }
+}
+
+/**
+ * draw one 3D triangle with texture. The triangle outside the view frustum is culled, and the triangle crossing
+ * the near plane or the guard band is clipped in the homogeneous space and drawn as a fan of triangles.
  * @param q0 homogeneous coordinate of 3D point 0
  * @param uv0 uv coordinate of point 0
  * @param img_data_out output image data
- * @param img_data_tex texture image data
+ * @param tex texture
+ * @param filter filter used to sample the texture
+ * @param clip only the pixels in this rectangle are drawn
  */
 void draw_3d_triangle_with_texture(
     const Eigen::Vector4f &q0,
@@ -48,52 +162,86 @@ void draw_3d_triangle_with_texture(
     unsigned int width_out,
     unsigned int height_out,
     std::vector<unsigned char> &img_data_out,
-    unsigned int width_tex,
-    unsigned int height_tex,
-    std::vector<unsigned char> &img_data_tex) {
-  for (unsigned int ih = 0; ih < height_out; ++ih) {
-    for (unsigned int iw = 0; iw < width_out; ++iw) {
-      const auto s = Eigen::Vector2f( // coordinate of the pixel in the normalized device coordinate [-1,1]^2
-          ((float(iw) + 0.5f) * 2.f) / float(width_out) - 1.f,
-          1.f - ((float(ih) + 0.5f) * 2.f) / float(height_out));
-      const auto r0 = q0.hnormalized()({0,1}); // coordinate of the point 0 in the normalized device coordinate [-1,1]^2
-      const auto r1 = q1.hnormalized()({0,1});
-      const auto r2 = q2.hnormalized()({0,1});
-      const float area0 = (r1 - s).cross(r2 - s);  // area of the 2d triangle connecting (s, r1, r2)
-      const float area1 = (r2 - s).cross(r0 - s);
-      const float area2 = (r0 - s).cross(r1 - s);
-      if (area0 < 0. || area1 < 0. || area2 < 0.) { continue; } // the pixel is outside the triangle (r0, r1, r2)
-      Eigen::Vector3f bc = Eigen::Vector3f(area0, area1, area2) / (area0 + area1 + area2); // barycentric coordinate on screen
-      // `bc` gives the barycentric coordinate **on the screen** and it is distorted.
-      // Compute the barycentric coordinate ***on the 3d triangle** below that gives the correct texture mapping.
-      // (Hint: formulate a linear system with 4x4 coefficient matrix and solve it to get the barycentric coordinate)
-      Eigen::Matrix4f coeff;
-      Eigen::Vector4f rhs;
+    const acg::MipmapTexture &tex,
+    acg::TextureFilter filter,
+    const acg::PixelRect &clip = acg::PixelRect()) {
+  acg::ClippedPolygon<Eigen::Vector2f> polygon;
+  const acg::ClipResult res = acg::clip_triangle<Eigen::Vector2f>({q0, q1, q2}, {uv0, uv1, uv2}, polygon);
+  if (res == acg::ClipResult::Outside) { return; }
+  if (res == acg::ClipResult::Inside) {
+    draw_projected_triangle_with_texture(
+        q0, q1, q2, uv0, uv1, uv2, width_out, height_out, img_data_out, tex, filter, clip);
+    return;
+  }
+  for (unsigned int i = 1; i + 1 < polygon.num_vtx; ++i) {
+    draw_projected_triangle_with_texture(
+        polygon.vtx2q[0], polygon.vtx2q[i], polygon.vtx2q[i + 1],
+        polygon.vtx2attr[0], polygon.vtx2attr[i], polygon.vtx2attr[i + 1],
+        width_out, height_out, img_data_out, tex, filter, clip);
+  }
+}
 
-      // do not change below
-      auto uv = uv0 * bc[0] + uv1 * bc[1] + uv2 * bc[2]; // uv coordinate of the pixel
-      // compute pixel coordinate of the texture
-      auto iw_tex = static_cast<unsigned int>((uv[0] - std::floor(uv[0])) * float(width_tex));
-      auto ih_tex = static_cast<unsigned int>((1.0 - uv[1] - std::floor(uv[1])) * float(height_tex));
-      // write to the output image
-      img_data_out[(ih * width_out + iw) * 3 + 0] = img_data_tex[(ih_tex * width_tex + iw_tex) * 3 + 0];
-      img_data_out[(ih * width_out + iw) * 3 + 1] = img_data_tex[(ih_tex * width_tex + iw_tex) * 3 + 1];
-      img_data_out[(ih * width_out + iw) * 3 + 2] = img_data_tex[(ih_tex * width_tex + iw_tex) * 3 + 2];
-    }
+/**
+ * model transformation fitting the bounding box of the mesh in the view
+ */
+Eigen::Affine3f model_transformation(
+    const Eigen::Vector3f &aabb_min,
+    const Eigen::Vector3f &aabb_max) {
+  const float aabb_size = (aabb_max - aabb_min).maxCoeff();
+  Eigen::Affine3f model = Eigen::Affine3f::Identity();
+  model.linear() = Eigen::AngleAxisf(float(M_PI), Eigen::Vector3f::UnitY()).matrix() * (2.f / aabb_size);
+  model.translation() = -model.linear() * (aabb_min + aabb_max) * 0.5f;
+  return model;
+}
+
+/**
+ * draw the mesh fitted in the view with the Lambertian shading and the depth test
+ * @param vtx2nrm normals of the vertices
+ * @param aabb_min corner of the bounding box of the mesh
+ * @param transform_xyz2ndc transformation of the camera
+ * @param img_gray grayscale output image
+ * @return numbers of the culled, clipped and drawn triangles
+ */
+acg::DrawMeshStatistics draw_mesh_gray(
+    const Eigen::Ref<const Eigen::Matrix<unsigned int, 3, Eigen::Dynamic>> &tri2vtx,
+    const Eigen::Ref<const Eigen::Matrix3Xf> &vtx2xyz,
+    const Eigen::Ref<const Eigen::Matrix3Xf> &vtx2nrm,
+    const Eigen::Vector3f &aabb_min,
+    const Eigen::Vector3f &aabb_max,
+    const Eigen::Matrix4f &transform_xyz2ndc,
+    unsigned int width_img,
+    unsigned int height_img,
+    std::vector<unsigned char> &img_gray) {
+  // fit the mesh in the view by the model transformation instead of modifying the coordinates
+  const Eigen::Affine3f model = model_transformation(aabb_min, aabb_max);
+  const Eigen::Matrix3f rot = Eigen::AngleAxisf(float(M_PI), Eigen::Vector3f::UnitY()).matrix();
+  // shading intensity at the vertices by the Lambertian reflection
+  const Eigen::Vector3f light_dir = rot.transpose() * Eigen::Vector3f(0.3f, 0.5f, 1.f).normalized(); // in the model
+  std::vector<float> vtx2intensity(vtx2xyz.cols());
+  for (unsigned int i_vtx = 0; i_vtx < vtx2xyz.cols(); ++i_vtx) {
+    vtx2intensity[i_vtx] = 0.2f + 0.8f * std::max(0.f, vtx2nrm.col(i_vtx).dot(light_dir));
   }
+  const Eigen::Matrix4Xf vtx2q = acg::transform_vertices(transform_xyz2ndc * model.matrix(), vtx2xyz);
+  acg::DepthBuffer depth_buffer(width_img, height_img);
+  return acg::draw_mesh_depth(tri2vtx, vtx2q, vtx2intensity, depth_buffer, img_gray);
 }
 
-int main() {
+int main(int argc, char *argv[]) {
   // texture image data
-  int width_tex, height_tex;
+  int width_tex, height_tex, bitdepth_tex;
   std::vector<unsigned char> img_data_tex;
   { // read texture image
-    int bitdepth0;
     const auto input_tex_path = std::filesystem::path(PROJECT_SOURCE_DIR) / ".." / "asset" / "uv.png";
-    unsigned char *ptr = stbi_load(input_tex_path.string().c_str(), &width_tex, &height_tex, &bitdepth0, 0);
-    img_data_tex = std::vector<unsigned char>(ptr, ptr + width_tex * height_tex * bitdepth0);
+    unsigned char *ptr = stbi_load(input_tex_path.string().c_str(), &width_tex, &height_tex, &bitdepth_tex, 0);
+    img_data_tex = std::vector<unsigned char>(ptr, ptr + width_tex * height_tex * bitdepth_tex);
     free(ptr);
   }
+  const acg::MipmapTexture tex(width_tex, height_tex, img_data_tex, bitdepth_tex); // pyramid built once
+  acg::TextureFilter filter = acg::TextureFilter::Nearest;
+  for (int i_arg = 1; i_arg < argc; ++i_arg) { // e.g., "./task03 trilinear" or "./task03 tiles anisotropic"
+    if (std::string(argv[i_arg]) == "trilinear") { filter = acg::TextureFilter::Trilinear; }
+    if (std::string(argv[i_arg]) == "anisotropic") { filter = acg::TextureFilter::Anisotropic; }
+  }
   const auto p0 = Eigen::Vector3f(-1.0, -1.0, +1.0); // 3d coordinate of point 0
   const auto p1 = Eigen::Vector3f(+1.0, -1.0, +1.0);
   const auto p2 = Eigen::Vector3f(+1.0, +1.0, -1.0);
@@ -112,19 +260,126 @@ int main() {
   const unsigned int width_img = 300;
   const unsigned int height_img = 300;
   std::vector<unsigned char> img_data(height_img * width_img * 3, 0); // grayscale image initialized white
+  const auto output_file_path = std::filesystem::path(PROJECT_SOURCE_DIR) / "output.png";
+  if (argc > 3 && std::string(argv[1]) == "convert") { // e.g., "./task03 convert mesh.obj mesh.acgm [epsilon]"
+    auto obj = acg::read_wavefrontobj(argv[2]);
+    if (!obj) { std::cout << "File Read Fail" << std::endl; return 1; }
+    if (obj->vtx2uv.empty() && obj->vtx2nrm.empty()) { // welding would merge the seams of the attributes otherwise
+      const float epsilon = argc > 4 ? std::stof(argv[4]) : 0.f; // by default, merge the vertices at the same position
+      const auto[tri2vtx, vtx2xyz] = acg::condition_triangle_mesh(
+          Eigen::Map<const Eigen::Matrix<unsigned int, 3, Eigen::Dynamic>>(obj->tri2vtx.data(), 3, obj->tri2vtx.size() / 3),
+          Eigen::Map<const Eigen::Matrix3Xf>(obj->vtx2xyz.data(), 3, obj->vtx2xyz.size() / 3),
+          epsilon);
+      std::cout << "conditioning: " << obj->vtx2xyz.size() / 3 << " -> " << vtx2xyz.cols() << " vertices, ";
+      std::cout << obj->tri2vtx.size() / 3 << " -> " << tri2vtx.cols() << " triangles" << std::endl;
+      obj->tri2vtx.assign(tri2vtx.data(), tri2vtx.data() + tri2vtx.size());
+      obj->vtx2xyz.assign(vtx2xyz.data(), vtx2xyz.data() + vtx2xyz.size());
+      obj->tri2uv.clear();
+      obj->tri2nrm.clear();
+    }
+    if (!acg::write_mesh_binary(argv[3], *obj)) { std::cout << "File Write Fail" << std::endl; return 1; }
+    std::cout << obj->tri2vtx.size() / 3 << " triangles are written to " << argv[3] << std::endl;
+    // sizes of the index buffer in the compact forms (the binary mesh keeps 32-bit indices to map them as they are)
+    const acg::CompactIndexBuffer indices_compact(
+        Eigen::Map<const Eigen::Matrix<unsigned int, 3, Eigen::Dynamic>>(obj->tri2vtx.data(), 3, obj->tri2vtx.size() / 3));
+    const std::vector<unsigned char> indices_varint = acg::encode_indices_delta_varint(obj->tri2vtx);
+    if (acg::decode_indices_delta_varint(indices_varint) != obj->tri2vtx) { std::cout << "Index Encode Fail" << std::endl; return 1; }
+    std::cout << "index buffer: " << obj->tri2vtx.size() * 4 << " bytes (32-bit), ";
+    std::cout << indices_compact.data.size() << " bytes (" << indices_compact.bytes_per_index * 8 << "-bit), ";
+    std::cout << indices_varint.size() << " bytes (delta varint)" << std::endl;
+    return 0;
+  }
+  if (argc > 1 && std::string(argv[1]) == "mesh") { // draw a mesh with the depth test, e.g., "./task03 mesh mesh.acgm"
+    const auto file_path = argc > 2 ?
+        std::filesystem::path(argv[2]) : std::filesystem::path(PROJECT_SOURCE_DIR) / ".." / "asset" / "armadillo.obj";
+    std::vector<unsigned char> img_gray(width_img * height_img, 0);
+    if (file_path.extension() == ".acgm") { // the arrays are used in the mapped file without copying
+      const acg::MeshBinary mesh(file_path);
+      if (!mesh.is_open()) { std::cout << "File Read Fail" << std::endl; return 1; }
+      const Eigen::Matrix3Xf vtx2nrm = mesh.has_normal() ?
+          Eigen::Matrix3Xf() : acg::vertex_normals_of_triangle_mesh(mesh.tri2vtx(), mesh.vtx2xyz());
+      draw_mesh_gray(
+          mesh.tri2vtx(), mesh.vtx2xyz(), mesh.has_normal() ? mesh.vtx2nrm() : Eigen::Map<const Eigen::Matrix3Xf>(
+              vtx2nrm.data(), 3, vtx2nrm.cols()), mesh.aabb_min(), mesh.aabb_max(),
+          transform_xyz2ndc, width_img, height_img, img_gray).print();
+    } else {
+      const auto[tri2vtx, vtx2xyz] = acg::read_wavefrontobj_as_3d_triangle_mesh(file_path.string().c_str());
+      if (vtx2xyz.cols() == 0) { return 1; }
+      const Eigen::Matrix3Xf vtx2nrm = acg::vertex_normals_of_triangle_mesh(tri2vtx, vtx2xyz);
+      draw_mesh_gray(
+          tri2vtx, vtx2xyz, vtx2nrm, vtx2xyz.rowwise().minCoeff(), vtx2xyz.rowwise().maxCoeff(),
+          transform_xyz2ndc, width_img, height_img, img_gray).print();
+    }
+    stbi_write_png(output_file_path.string().c_str(), width_img, height_img, 1, img_gray.data(), width_img);
+    return 0;
+  }
+  if (argc > 1 && std::string(argv[1]) == "lod") { // draw the level of detail for the size, e.g., "./task03 lod 64"
+    const unsigned int size_img = argc > 2 ? std::stoi(argv[2]) : width_img;
+    const auto file_path = argc > 3 ?
+        std::filesystem::path(argv[3]) : std::filesystem::path(PROJECT_SOURCE_DIR) / ".." / "asset" / "armadillo.obj";
+    const auto[tri2vtx, vtx2xyz] = acg::read_wavefrontobj_as_3d_triangle_mesh(file_path.string().c_str());
+    if (vtx2xyz.cols() == 0 || size_img == 0) { return 1; }
+    const Eigen::MatrixXf vtx2nrm = acg::vertex_normals_of_triangle_mesh(tri2vtx, vtx2xyz);
+    const std::vector<acg::MeshLod> lods = acg::lod_chain_of_triangle_mesh(tri2vtx, vtx2xyz, vtx2nrm);
+    const Eigen::Vector3f aabb_min = vtx2xyz.rowwise().minCoeff(), aabb_max = vtx2xyz.rowwise().maxCoeff();
+    const float pixels_per_unit = acg::pixels_per_unit_on_screen(
+        transform_xyz2ndc * model_transformation(aabb_min, aabb_max).matrix(), (aabb_min + aabb_max) * 0.5f,
+        size_img, size_img);
+    const unsigned int i_lod = acg::select_lod(lods, pixels_per_unit);
+    for (unsigned int i = 0; i < lods.size(); ++i) {
+      std::cout << (i == i_lod ? "* " : "  ") << "level " << i << ": " << lods[i].tri2vtx.cols() << " triangles, ";
+      std::cout << "error " << lods[i].error * pixels_per_unit << " pixels" << std::endl;
+    }
+    const acg::MeshLod &lod = lods[i_lod];
+    // the normals are interpolated in the simplification and need the normalization
+    const Eigen::Matrix3Xf lod2nrm = lod.vtx2attr.colwise().normalized();
+    std::vector<unsigned char> img_gray(size_img * size_img, 0);
+    draw_mesh_gray(lod.tri2vtx, lod.vtx2xyz, lod2nrm, aabb_min, aabb_max, transform_xyz2ndc, size_img, size_img, img_gray).print();
+    stbi_write_png(output_file_path.string().c_str(), size_img, size_img, 1, img_gray.data(), size_img);
+    return 0;
+  }
+  if (argc > 1 && std::string(argv[1]) == "tiles") { // draw the triangles tile by tile in parallel
+    const std::array<Eigen::Vector4f, 4> vtx2q = {q0, q1, q2, q3};
+    const std::array<Eigen::Vector2f, 4> vtx2uv = {uv0, uv1, uv2, uv3};
+    const unsigned int tri2vtx[2][3] = {{0, 1, 2}, {0, 2, 3}};
+    acg::TileScheduler scheduler(width_img, height_img);
+    scheduler.bin(2, [&](unsigned int i_tri) -> std::array<float, 4> {
+      std::array<float, 4> b = {float(width_img), float(height_img), 0.f, 0.f};
+      for (unsigned int i_vtx: tri2vtx[i_tri]) {
+        if (vtx2q[i_vtx].w() <= 0.f) { return {0.f, 0.f, float(width_img), float(height_img)}; } // will be clipped
+        const Eigen::Vector2f r = vtx2q[i_vtx].hnormalized().head<2>();
+        const float x = (r.x() + 1.f) * 0.5f * float(width_img); // pixel coordinate
+        const float y = (1.f - r.y()) * 0.5f * float(height_img);
+        b = {std::min(b[0], x), std::min(b[1], y), std::max(b[2], x), std::max(b[3], y)};
+      }
+      return b;
+    });
+    scheduler.run([&](const acg::Tile &tile) {
+      for (unsigned int i = 0; i < tile.num_prim; ++i) {
+        const unsigned int *v = tri2vtx[tile.prims[i]];
+        draw_3d_triangle_with_texture(
+            vtx2q[v[0]], vtx2q[v[1]], vtx2q[v[2]],
+            vtx2uv[v[0]], vtx2uv[v[1]], vtx2uv[v[2]],
+            width_img, height_img, img_data,
+            tex, filter, tile.rect);
+      }
+    });
+    scheduler.print_statistics();
+    stbi_write_png(output_file_path.string().c_str(), width_img, height_img, 3, img_data.data(), width_img * 3);
+    return 0;
+  }
   // draw first triangle connecting point 0,1,2
   draw_3d_triangle_with_texture(
       q0, q1, q2,
       uv0, uv1, uv2,
       width_img, height_img, img_data,
-      width_tex, height_tex, img_data_tex);
+      tex, filter);
   // draw second triangle connecting point 0,2,3
   draw_3d_triangle_with_texture(
       q0, q2, q3,
       uv0, uv2, uv3,
       width_img, height_img, img_data,
-      width_tex, height_tex, img_data_tex);
+      tex, filter);
   // write output image
-  const auto output_file_path = std::filesystem::path(PROJECT_SOURCE_DIR) / "output.png";
   stbi_write_png(output_file_path.string().c_str(), width_img, height_img, 3, img_data.data(), width_img * 3);
 }
@@ -6,6 +6,7 @@
 //
 #include "../src/util_opengl.h"
 #include "../src/util_triangle_mesh.h"
+#include "../src/mesh_optimize.h"
 //
 #ifndef  M_PI
 #define  M_PI  3.1415926535897932384626433
@@ -39,6 +40,17 @@ void draw(
 int main() {
   const auto file_path = std::filesystem::path(PROJECT_SOURCE_DIR) / ".." / "asset" / "armadillo.obj";
   auto[tri2vtx, vtx2xyz] = acg::read_wavefrontobj_as_3d_triangle_mesh(file_path.string().c_str());
+  { // reorder the triangles for the vertex cache and the overdraw, then the vertices for the fetch
+    const auto num_vtx = static_cast<unsigned int>(vtx2xyz.cols());
+    const auto stat0 = acg::vertex_cache_statistics(tri2vtx, num_vtx);
+    tri2vtx = acg::optimize_vertex_cache(tri2vtx, num_vtx);
+    tri2vtx = acg::optimize_overdraw(tri2vtx, vtx2xyz);
+    const auto vtx2new = acg::optimize_vertex_fetch(tri2vtx, num_vtx);
+    vtx2xyz = acg::permute_vertices(vtx2xyz, vtx2new);
+    const auto stat1 = acg::vertex_cache_statistics(tri2vtx, num_vtx);
+    std::cout << "ACMR " << stat0.acmr << " -> " << stat1.acmr;
+    std::cout << ", ATVR " << stat0.atvr << " -> " << stat1.atvr << std::endl;
+  }
   // bounding box
   auto aabb_max = vtx2xyz.rowwise().maxCoeff();
   auto aabb_min = vtx2xyz.rowwise().minCoeff();
@@ -3,6 +3,7 @@
 #include <fstream>
 #include <optional>
 #include <chrono>
+#include <string>
 //
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #include "stb_image_write.h"
@@ -10,6 +11,7 @@
 #include "Eigen/Geometry"
 //
 #include "util.h"
+#include "../src/denoise.h"
 
 #ifndef M_PI
 #define M_PI 3.14159265358979323846
@@ -184,7 +186,139 @@ auto get_ray_from_camera(
   return {cam_ray_src, cam_ray_dir};
 }
 
-int main() {
+/**
+ * compute one sample of the ambient occlusion
+ * @param pos position of the first hit point
+ * @param nrm normal of the first hit point
+ * @return value of the sample. The ambient occlusion is the average of this value
+ */
+float sample_ambient_occlusion(
+    const Eigen::Vector3f &pos,
+    const Eigen::Vector3f &nrm,
+    const Eigen::MatrixX3i &tri2vtx,
+    const Eigen::MatrixX3f &vtx2xyz,
+    const std::vector<acg::BvhNode> &bvhnodes) {
+  Eigen::Vector3f pos0 = pos + nrm * 0.001f; // offset the position in the direction of normal
+  const auto[dir, pdf] = sample_hemisphere(nrm); // direction of the sampled light position and its PDF
+  const auto res1 = find_intersection_between_ray_and_triangle_mesh(
+      pos0, dir, tri2vtx, vtx2xyz, bvhnodes);
+  if (!res1) { // if the ray doe not hit anything
+    return 1.f; // Problem 3: This is a bug. write some correct code (hint: use `dir.dot(nrm)`, `pdf`, `M_PI`).
+  }
+  return 0.f;
+}
+
+/**
+ * Render the ambient occlusion progressively, adding one sample per pixel over the whole image in each pass
+ * until the wall-clock budget or the total sample budget runs out.
+ * @param time_budget wall-clock budget in seconds (no limit if it is not positive)
+ * @param sample_budget total number of the ambient occlusion samples over the image (no limit if zero)
+ * @param[out] img_data_nrm normal map of the first hits
+ * @param[out] img_data_ao ambient occlusion image
+ * @param[out] aux features of the first hits to guide the denoiser
+ * @return number of the samples per pixel (zero if the budget runs out before the first pass)
+ */
+unsigned int render_ambient_occlusion_with_budget(
+    unsigned int img_width,
+    unsigned int img_height,
+    double time_budget,
+    unsigned long long sample_budget,
+    const Eigen::MatrixX3i &tri2vtx,
+    const Eigen::MatrixX3f &vtx2xyz,
+    const std::vector<acg::BvhNode> &bvhnodes,
+    std::vector<float> &img_data_nrm,
+    std::vector<float> &img_data_ao,
+    acg::AuxiliaryBuffers &aux) {
+  const auto start = std::chrono::steady_clock::now();
+  auto seconds = [&start]() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  };
+  std::vector<std::optional<std::pair<Eigen::Vector3f, Eigen::Vector3f>>> pix2hit(img_width * img_height);
+  unsigned int num_hit = 0;
+  for (unsigned int ih = 0; ih < img_height; ++ih) {
+    for (unsigned int iw = 0; iw < img_width; ++iw) {
+      const auto[cam_ray_src, cam_ray_dir] = get_ray_from_camera(img_width, img_height, iw, ih);
+      pix2hit[ih * img_width + iw] = find_intersection_between_ray_and_triangle_mesh(
+          cam_ray_src, cam_ray_dir, tri2vtx, vtx2xyz, bvhnodes);
+      if (!pix2hit[ih * img_width + iw]) { continue; }
+      num_hit++;
+      const auto&[pos, nrm] = pix2hit[ih * img_width + iw].value();
+      for (unsigned int i_dim = 0; i_dim < 3; ++i_dim) {
+        img_data_nrm[(ih * img_width + iw) * 3 + i_dim] = nrm[i_dim] * 0.5f + 0.5f;
+      }
+      aux.set(ih * img_width + iw, nrm.x(), nrm.y(), nrm.z(), (pos - cam_ray_src).norm(), 1.f, 0);
+    }
+  }
+  std::vector<float> pix2sum(img_width * img_height, 0.f);
+  unsigned long long num_ray = img_width * img_height;
+  unsigned long long num_sample = 0;
+  unsigned int num_pass = 0;
+  for (;; ++num_pass) {
+    if (time_budget > 0. && seconds() > time_budget) { break; }
+    if (sample_budget > 0 && num_sample + num_hit > sample_budget) { break; }
+    if (time_budget <= 0. && sample_budget == 0) { break; } // no budget is specified
+    if (num_hit == 0) { break; } // nothing to sample
+    for (unsigned int i_pix = 0; i_pix < img_width * img_height; ++i_pix) {
+      if (!pix2hit[i_pix]) { continue; }
+      const auto&[pos, nrm] = pix2hit[i_pix].value();
+      pix2sum[i_pix] += sample_ambient_occlusion(pos, nrm, tri2vtx, vtx2xyz, bvhnodes);
+    }
+    num_sample += num_hit;
+    num_ray += num_hit;
+  }
+  for (unsigned int i_pix = 0; i_pix < img_width * img_height; ++i_pix) {
+    img_data_ao[i_pix] = num_pass > 0 ? pix2sum[i_pix] / float(num_pass) : 0.f;
+  }
+  const double elapsed = seconds();
+  std::cout << "samples per pixel: " << num_pass << std::endl;
+  std::cout << "computation time: " << elapsed << "s" << std::endl;
+  std::cout << "rays per second: " << double(num_ray) / elapsed << std::endl;
+  return num_pass;
+}
+
+/**
+ * write the normal map, the ambient occlusion and the denoised ambient occlusion
+ */
+void output_images(
+    unsigned int img_width,
+    unsigned int img_height,
+    const std::vector<float> &img_data_nrm,
+    const std::vector<float> &img_data_ao,
+    const acg::AuxiliaryBuffers &aux) {
+  {
+    std::vector<unsigned char> img_data_uchar(img_width * img_height * 3, 0);
+    for (unsigned int i = 0; i < img_width * img_height; ++i) {
+      img_data_uchar[i * 3 + 0] = static_cast<unsigned char>(img_data_nrm[i * 3 + 0] * 255.f);
+      img_data_uchar[i * 3 + 1] = static_cast<unsigned char>(img_data_nrm[i * 3 + 1] * 255.f);
+      img_data_uchar[i * 3 + 2] = static_cast<unsigned char>(img_data_nrm[i * 3 + 2] * 255.f);
+    }
+    stbi_write_png(
+        (std::filesystem::path(PROJECT_SOURCE_DIR) / "normal_map.png").string().c_str(),
+        img_width, img_height, 3, img_data_uchar.data(), 0);
+  }
+  {
+    std::vector<unsigned char> img_data_uchar(img_width * img_height, 0);
+    for (unsigned int i = 0; i < img_width * img_height; ++i) {
+      img_data_uchar[i] = static_cast<unsigned char>(img_data_ao[i] * 255.f);
+    }
+    stbi_write_png(
+        (std::filesystem::path(PROJECT_SOURCE_DIR) / "ao.png").string().c_str(),
+        img_width, img_height, 1, img_data_uchar.data(), 0);
+  }
+  { // ambient occlusion denoised with the guide of the normal and the depth
+    std::vector<float> img_data_ao_denoised = img_data_ao;
+    acg::denoise_atrous(img_data_ao_denoised, 1, aux);
+    std::vector<unsigned char> img_data_uchar(img_width * img_height, 0);
+    for (unsigned int i = 0; i < img_width * img_height; ++i) {
+      img_data_uchar[i] = static_cast<unsigned char>(std::clamp(img_data_ao_denoised[i], 0.f, 1.f) * 255.f);
+    }
+    stbi_write_png(
+        (std::filesystem::path(PROJECT_SOURCE_DIR) / "ao_denoised.png").string().c_str(),
+        img_width, img_height, 1, img_data_uchar.data(), 0);
+  }
+}
+
+int main(int argc, char *argv[]) {
   Eigen::MatrixX3f vtx2xyz;
   Eigen::MatrixX3i tri2vtx;
   std::vector<acg::BvhNode> bvhnodes;
@@ -195,7 +329,25 @@ int main() {
   //
   std::vector<float> img_data_nrm(img_height * img_width * 3, 0.f);
   std::vector<float> img_data_ao(img_height * img_width, 0.f);
+  acg::AuxiliaryBuffers aux(img_width, img_height); // features to guide the denoiser
   //
+  if (argc > 1 && std::string(argv[1]) == "budget") { // usage: task06 budget <time_budget_sec> [sample_budget]
+    const double time_budget = argc > 2 ? std::stod(argv[2]) : 10.;
+    const unsigned long long sample_budget = argc > 3 ? std::stoull(argv[3]) : 0;
+    if (time_budget <= 0. && sample_budget == 0) {
+      std::cout << "specify the time budget or the sample budget" << std::endl;
+      return 1;
+    }
+    const unsigned int num_pass = render_ambient_occlusion_with_budget(
+        img_width, img_height, time_budget, sample_budget,
+        tri2vtx, vtx2xyz, bvhnodes, img_data_nrm, img_data_ao, aux);
+    if (num_pass == 0) {
+      std::cout << "the budget is less than one sample per pixel, no image is written" << std::endl;
+      return 1;
+    }
+    output_images(img_width, img_height, img_data_nrm, img_data_ao, aux);
+    return 0;
+  }
   std::chrono::system_clock::time_point start = std::chrono::system_clock::now(); // record starting time
   for (unsigned int iw = 0; iw < img_width; ++iw) {
     for (unsigned int ih = 0; ih < img_height; ++ih) {
@@ -212,6 +364,7 @@ int main() {
         img_data_nrm[(ih * img_width + iw) * 3 + 0] = nrm.x() * 0.5f + 0.5f;
         img_data_nrm[(ih * img_width + iw) * 3 + 1] = nrm.y() * 0.5f + 0.5f;
         img_data_nrm[(ih * img_width + iw) * 3 + 2] = nrm.z() * 0.5f + 0.5f;
+        aux.set(ih * img_width + iw, nrm.x(), nrm.y(), nrm.z(), (pos - cam_ray_src).norm(), 1.f, 0);
       }
       continue; // comment out here for Problem 3,4
       //
@@ -220,13 +373,7 @@ int main() {
         float sum = 0;
         for (unsigned int i_sample = 0; i_sample < num_sample_ao; ++i_sample) {
           const auto&[pos, nrm] = res.value(); // position and normal of the first hit point
-          Eigen::Vector3f pos0 = pos + nrm * 0.001f; // offset the position in the direction of normal
-          const auto[dir, pdf] = sample_hemisphere(nrm); // direction of the sampled light position and its PDF
-          const auto res1 = find_intersection_between_ray_and_triangle_mesh(
-              pos0, dir, tri2vtx, vtx2xyz, bvhnodes);
-          if (!res1) { // if the ray doe not hit anything
-            sum += 1.f; // Problem 3: This is a bug. write some correct code (hint: use `dir.dot(nrm)`, `pdf`, `M_PI`).
-          }
+          sum += sample_ambient_occlusion(pos, nrm, tri2vtx, vtx2xyz, bvhnodes);
         }
         img_data_ao[ih * img_width + iw] = sum / float(num_sample_ao); // do not change
       }
@@ -235,26 +382,6 @@ int main() {
   std::chrono::system_clock::time_point end = std::chrono::system_clock::now(); // record end time
   auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
   std::cout << "total computation time: " << elapsed << "ms" << std::endl;
-
-  {
-    std::vector<unsigned char> img_data_uchar(img_width * img_height * 3, 0);
-    for (unsigned int i = 0; i < img_width * img_height; ++i) {
-      img_data_uchar[i * 3 + 0] = static_cast<unsigned char>(img_data_nrm[i * 3 + 0] * 255.f);
-      img_data_uchar[i * 3 + 1] = static_cast<unsigned char>(img_data_nrm[i * 3 + 1] * 255.f);
-      img_data_uchar[i * 3 + 2] = static_cast<unsigned char>(img_data_nrm[i * 3 + 2] * 255.f);
-    }
-    stbi_write_png(
-        (std::filesystem::path(PROJECT_SOURCE_DIR) / "normal_map.png").string().c_str(),
-        img_width, img_height, 3, img_data_uchar.data(), 0);
-  }
-  {
-    std::vector<unsigned char> img_data_uchar(img_width * img_height, 0);
-    for (unsigned int i = 0; i < img_width * img_height; ++i) {
-      img_data_uchar[i] = static_cast<unsigned char>(img_data_ao[i] * 255.f);
-    }
-    stbi_write_png(
-        (std::filesystem::path(PROJECT_SOURCE_DIR) / "ao.png").string().c_str(),
-        img_width, img_height, 1, img_data_uchar.data(), 0);
-  }
+  output_images(img_width, img_height, img_data_nrm, img_data_ao, aux);
 }
 
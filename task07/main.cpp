@@ -5,6 +5,13 @@
 #include <random>
 #include <optional>
 #include <cmath>
+#include <vector>
+#include <array>
+#include <chrono>
+#include <algorithm>
+#include <string>
+#include <cstring>
+#include <cstdint>
 //
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #include "stb_image_write.h"
@@ -12,6 +19,9 @@
 #include "stb_image.h"
 #include "Eigen/Core"
 #include "Eigen/Geometry"
+//
+#include "../src/denoise.h"
+#include "../src/mapped_file.h"
 
 #ifndef M_PI
 #define M_PI 3.14159265358979323846
@@ -51,6 +61,104 @@ auto local_to_world_vector_transformation(
   return loc2world;
 }
 
+/**
+ * fast approximation of log2(x) for x > 0 (absolute error is less than 3e-6)
+ */
+inline float fast_log2(float x) {
+  uint32_t bits;
+  std::memcpy(&bits, &x, sizeof(float));
+  const auto exponent = float(int((bits >> 23) & 0xff) - 127);
+  bits = (bits & 0x007fffff) | 0x3f800000; // mantissa in [1,2)
+  float m;
+  std::memcpy(&m, &bits, sizeof(float));
+  const float t = m - 1.f;
+  // least-squares fit of log2(1+t)/t on [0,1)
+  const float p = 1.44253478f + t * (-0.71803359f + t * (0.457158121f
+      + t * (-0.277341646f + t * (0.121472948f + t * -0.025792345f))));
+  return exponent + t * p;
+}
+
+/**
+ * fast approximation of 2^x (relative error is less than 2e-7 for x > -126)
+ */
+inline float fast_exp2(float x) {
+  x = std::max(x, -126.f);
+  const float fl = std::floor(x);
+  const float t = x - fl;
+  // least-squares fit of 2^t on [0,1)
+  const float p = 0.999999896f + t * (0.69315462f + t * (0.24014077f
+      + t * (0.0558632827f + t * (0.00894621467f + t * 0.00189510729f))));
+  const uint32_t bits = uint32_t(int(fl) + 127) << 23;
+  float scale;
+  std::memcpy(&scale, &bits, sizeof(float));
+  return p * scale;
+}
+
+/**
+ * Specular lobe of the Phong BRDF `(shiness + 1) / (2 pi) * cos^shiness`.
+ * The constants are computed once per material so that no `std::pow` is called per sample.
+ * Integer shiness is evaluated exactly by repeated squaring,
+ * otherwise `fast_exp2(shiness * fast_log2(cos))` is used.
+ */
+class PhongLobe {
+ public:
+  float shiness;
+  float normalization; // (shiness + 1) / (2 pi)
+  float inv_exponent; // 1 / (shiness + 1) used for sampling
+  unsigned int int_shiness; // shiness as an integer if `is_integer`
+  bool is_integer;
+ public:
+  explicit PhongLobe(float shiness_)
+      : shiness(shiness_),
+        normalization((shiness_ + 1.f) / (2.f * float(M_PI))),
+        inv_exponent(1.f / (shiness_ + 1.f)),
+        int_shiness(static_cast<unsigned int>(std::max(shiness_, 0.f))),
+        is_integer(shiness_ >= 0.f && float(static_cast<unsigned int>(shiness_)) == shiness_) {}
+  /**
+   * value of the lobe
+   * @param cos_alpha cosine between the mirror direction and the outgoing direction
+   */
+  [[nodiscard]] float value(float cos_alpha) const {
+    const float c = std::max(cos_alpha, 0.f);
+    if (!is_integer) { return c > 0.f ? normalization * fast_exp2(shiness * fast_log2(c)) : 0.f; }
+    float v = 1.f, b = c;
+    for (unsigned int e = int_shiness; e; e >>= 1) {
+      if (e & 1) { v *= b; }
+      b *= b;
+    }
+    return normalization * v;
+  }
+  /**
+   * values of the lobe for many samples. Each inner loop is vectorized over the samples
+   * @param n number of samples
+   * @param[in,out] cos_alpha cosine between the mirror direction and the outgoing direction.
+   * It is overwritten as the scratch buffer of the powers, so no buffer is allocated per call
+   * @param[out] out value of the lobe
+   */
+  void values(size_t n, float *cos_alpha, float *out) const {
+    if (!is_integer) {
+      for (size_t i = 0; i < n; ++i) { out[i] = value(cos_alpha[i]); }
+      return;
+    }
+    float *base = cos_alpha;
+    for (size_t i = 0; i < n; ++i) {
+      base[i] = std::max(cos_alpha[i], 0.f);
+      out[i] = normalization;
+    }
+    for (unsigned int e = int_shiness; e; e >>= 1) {
+      if (e & 1) { for (size_t i = 0; i < n; ++i) { out[i] *= base[i]; }}
+      for (size_t i = 0; i < n; ++i) { base[i] *= base[i]; }
+    }
+  }
+  /**
+   * cosine of the angle from the mirror direction drawn from the lobe
+   * @param unirand uniform random number in [0,1)
+   */
+  [[nodiscard]] float sample_cos_alpha(float unirand) const {
+    return fast_exp2(fast_log2(1.f - unirand) * inv_exponent);
+  }
+};
+
 auto sampling_brdf_lambert(
     const Eigen::Vector3f &nrm,
     const Eigen::Vector2f &unirand) -> std::pair<Eigen::Vector3f, float> {
@@ -69,11 +177,11 @@ auto sampling_brdf_lambert(
 auto sampling_brdf_specular(
     const Eigen::Vector3f &nrm,
     const Eigen::Vector3f &dir_in,
-    float shiness,
+    const PhongLobe &lobe,
     const Eigen::Vector2f &unirand) -> std::pair<Eigen::Vector3f, float> {
   const Eigen::Vector3f dir_mirror = dir_in - 2.f * dir_in.dot(nrm) * nrm;
   const float phi = 2.f * float(M_PI) * unirand.y();
-  const float cos_alpha = std::pow(1.f - unirand.x(), 1.f / (shiness + 1.f));
+  const float cos_alpha = lobe.sample_cos_alpha(unirand.x());
   const float sin_alpha = std::sqrt(std::max(0.f, 1.f - cos_alpha * cos_alpha));
   const auto dir_loc = Eigen::Vector3f(
       sin_alpha * std::cos(phi),
@@ -82,7 +190,7 @@ auto sampling_brdf_specular(
   const Eigen::Matrix3f loc2world = local_to_world_vector_transformation(dir_mirror);
   const Eigen::Vector3f dir_out = loc2world * dir_loc;
   assert(dir_out.dot(nrm) > 0.f);
-  float brdf = std::pow(cos_alpha, shiness) * (shiness + 1.f) / (2.f * float(M_PI));
+  float brdf = lobe.value(cos_alpha);
   return {dir_out, brdf};
 }
 
@@ -93,7 +201,7 @@ auto sampling_brdf_specular(
  * @param dir_out outgoing light direction
  * @param ratio_diffuse how much incoming light diffuse
  * @param ratio_specular how much incoming light reflect as the specular light
- * @param shiness
+ * @param lobe specular lobe
  * @return probability density
  */
 float pdf_brdf_phong(
@@ -102,11 +210,11 @@ float pdf_brdf_phong(
     const Eigen::Vector3f &dir_out,
     float ratio_diffuse,
     float ratio_specular,
-    float shiness) {
+    const PhongLobe &lobe) {
   float pdf_diffuse = dir_out.dot(nrm) / float(M_PI);
   const Eigen::Vector3f dir_mirror = dir_in - 2.f * dir_in.dot(nrm) * nrm;
   float cos_alpha = dir_mirror.dot(dir_out);
-  float pdf_specular = std::pow(cos_alpha, shiness) * (shiness + 1.f) / (2.f * float(M_PI));
+  float pdf_specular = lobe.value(cos_alpha);
   return (pdf_diffuse * ratio_diffuse + pdf_specular * ratio_specular) / (ratio_diffuse + ratio_specular);
 }
 
@@ -118,6 +226,7 @@ class Sphere {
   const float ratio_specular;
   const float ratio_diffuse;
   const float emission;
+  const PhongLobe lobe = PhongLobe(shiness); // precomputed constants of the specular lobe
  public:
   /**
    * sampling the incoming light direction based on BRDF
@@ -141,7 +250,7 @@ class Sphere {
       auto hoge = sampling_brdf_lambert(nrm, unirand);
       dir_world = hoge.first;
     } else { // specular
-      auto hoge = sampling_brdf_specular(nrm, dir_out, shiness, unirand);
+      auto hoge = sampling_brdf_specular(nrm, dir_out, lobe, unirand);
       dir_world = hoge.first;
     }
     return dir_world;
@@ -160,7 +269,7 @@ class Sphere {
     if (ratio_specular <= 0.f && ratio_diffuse <= 0.f) { return 0.f; }
     const Eigen::Vector3f dir_mirror = dir_in - 2.f * dir_in.dot(dir_nrm) * dir_nrm;
     float cos_alpha = dir_mirror.dot(dir_out);
-    float brdf_specular = std::pow(cos_alpha, shiness) * (shiness + 1.f) / (2.f * float(M_PI));
+    float brdf_specular = lobe.value(cos_alpha);
     float brdf_diffuse = 1.f / float(M_PI);
     return brdf_specular * ratio_specular + brdf_diffuse * ratio_diffuse;
   }
@@ -177,7 +286,7 @@ class Sphere {
       const Eigen::Vector3f &dir_out) const {
     return pdf_brdf_phong(
         nrm, dir_in, dir_out,
-        ratio_diffuse, ratio_specular, shiness);
+        ratio_diffuse, ratio_specular, lobe);
   }
 };
 
@@ -326,7 +435,7 @@ void output_float_image(
     const std::vector<float>& img_data) {
   std::vector<unsigned char> img_u8(img_height * img_width, 0);
   for(int i=0;i<img_width*img_height;++i){
-    float data = img_data[img_height+i];
+    float data = std::clamp(img_data[i], 0.f, 1.f);
     auto c = static_cast<unsigned char>(std::pow(data,1./2.2)*255.0); // gamma correction
     img_u8[i] = c;
   }
@@ -335,7 +444,430 @@ void output_float_image(
       img_width, img_height, 1, img_u8.data(), img_width);
 }
 
-int main() {
+// --------------------------------------
+// wavefront path tracing
+
+/**
+ * Queue of rays stored as the structure of arrays.
+ * Each stage of the wavefront renderer is a flat loop over such a queue.
+ */
+class RayQueue {
+ public:
+  std::vector<unsigned int> ray2path; // index of the path this ray belongs to
+  std::vector<float> org_x, org_y, org_z; // ray origin
+  std::vector<float> dir_x, dir_y, dir_z; // ray direction
+  std::vector<float> weight; // how much the radiance of this ray contributes to the pixel
+  std::vector<int> hit_object; // index of the hit sphere (-1 if nothing is hit)
+  std::vector<float> hit_depth; // depth of the hit position
+ public:
+  [[nodiscard]] size_t size() const { return ray2path.size(); }
+  void clear() {
+    for (auto *v: {&org_x, &org_y, &org_z, &dir_x, &dir_y, &dir_z, &weight, &hit_depth}) { v->clear(); }
+    ray2path.clear();
+    hit_object.clear();
+  }
+  void push_back(
+      unsigned int i_path,
+      const Eigen::Vector3f &org,
+      const Eigen::Vector3f &dir) {
+    ray2path.push_back(i_path);
+    org_x.push_back(org.x());
+    org_y.push_back(org.y());
+    org_z.push_back(org.z());
+    dir_x.push_back(dir.x());
+    dir_y.push_back(dir.y());
+    dir_z.push_back(dir.z());
+    weight.push_back(0.f);
+  }
+  [[nodiscard]] Eigen::Vector3f dir(size_t i_ray) const { return {dir_x[i_ray], dir_y[i_ray], dir_z[i_ray]}; }
+};
+
+/**
+ * intersection stage: find the closest sphere for all the rays in the queue.
+ * Same as `intersection_ray_sphere` but written without branches to be vectorized over the rays.
+ * @param[in,out] queue rays. `hit_object` and `hit_depth` are overwritten
+ */
+void intersect_ray_queue(RayQueue &queue) {
+  const size_t num_ray = queue.size();
+  queue.hit_object.assign(num_ray, -1);
+  queue.hit_depth.assign(num_ray, std::numeric_limits<float>::max());
+  for (int i_sphere = 0; i_sphere < 4; ++i_sphere) {
+    const float cx = spheres[i_sphere].pos.x();
+    const float cy = spheres[i_sphere].pos.y();
+    const float cz = spheres[i_sphere].pos.z();
+    const float sqrad = spheres[i_sphere].rad * spheres[i_sphere].rad;
+    const float *ox = queue.org_x.data(), *oy = queue.org_y.data(), *oz = queue.org_z.data();
+    const float *dx = queue.dir_x.data(), *dy = queue.dir_y.data(), *dz = queue.dir_z.data();
+    float *hit_depth = queue.hit_depth.data();
+    int *hit_object = queue.hit_object.data();
+    for (size_t i_ray = 0; i_ray < num_ray; ++i_ray) {
+      const float px = cx - ox[i_ray], py = cy - oy[i_ray], pz = cz - oz[i_ray];
+      const float depth0 = px * dx[i_ray] + py * dy[i_ray] + pz * dz[i_ray];
+      const float qx = depth0 * dx[i_ray] - px, qy = depth0 * dy[i_ray] - py, qz = depth0 * dz[i_ray] - pz;
+      const float disc = sqrad - (qx * qx + qy * qy + qz * qz);
+      const float depth1 = depth0 - std::sqrt(std::max(disc, 0.f));
+      const bool is_hit = depth0 >= 0.f && disc >= 0.f && depth1 >= 0.f && depth1 < hit_depth[i_ray];
+      hit_depth[i_ray] = is_hit ? depth1 : hit_depth[i_ray];
+      hit_object[i_ray] = is_hit ? i_sphere : hit_object[i_ray];
+    }
+  }
+}
+
+/**
+ * Computation time of each stage of the wavefront renderer and the number of traced rays
+ */
+class WavefrontStatistics {
+ public:
+  size_t num_ray = 0; // number of rays intersected against the scene
+  static constexpr unsigned int num_stage = 5;
+  const std::array<const char *, num_stage> names = {"generate", "intersect", "sort", "shade", "shadow"};
+  std::array<double, num_stage> milliseconds = {0., 0., 0., 0., 0.};
+  std::chrono::steady_clock::time_point time_point = std::chrono::steady_clock::now();
+ public:
+  /**
+   * add elapsed time since the last call to the stage
+   * @param i_stage index of stage
+   */
+  void lap(unsigned int i_stage) {
+    const auto now = std::chrono::steady_clock::now();
+    milliseconds[i_stage] += std::chrono::duration<double, std::milli>(now - time_point).count();
+    time_point = now;
+  }
+  void print() const {
+    for (unsigned int i_stage = 0; i_stage < num_stage; ++i_stage) {
+      std::cout << "  " << names[i_stage] << ": " << milliseconds[i_stage] << "ms" << std::endl;
+    }
+  }
+};
+
+/**
+ * Render MIS image in the wavefront (queue-based) manner.
+ * Paths are processed in batches through the stages
+ * generate -> intersect -> sort by material/lobe -> shade -> shadow test.
+ * @param img_width width of the image
+ * @param img_height height of the image
+ * @param nsample number of samples per pixel (half for BRDF sampling, half for light sampling)
+ * @param rndeng random number generator
+ * @param[in,out] img_mis the estimated radiance is added to this image
+ * @param[in,out] timer computation time of each stage and the number of rays are accumulated
+ */
+void render_wavefront_mis(
+    unsigned int img_width,
+    unsigned int img_height,
+    unsigned int nsample,
+    std::mt19937 &rndeng,
+    std::vector<float> &img_mis,
+    WavefrontStatistics &timer) {
+  constexpr unsigned int num_pixel_batch = 4096; // number of paths processed at once
+  const unsigned int num_half_sample = nsample / 2;
+  auto udist01 = std::uniform_real_distribution<float>(0.f, 1.f);
+  RayQueue queue_camera;
+  RayQueue queue_shadow;
+  std::vector<unsigned int> path2pix;
+  std::vector<Eigen::Vector3f> path2pos, path2nrm, path2dir;
+  std::vector<unsigned int> path2object;
+  std::array<std::vector<unsigned int>, 4> object2paths; // paths bucketed by the material (i.e., sphere)
+  // samples bucketed by the material and the lobe (0: diffuse, 1: specular, 2: light sampling)
+  std::array<std::array<std::vector<unsigned int>, 3>, 4> object2lobe2paths;
+  std::vector<float> cos_theta, cos_alpha, lobe_value; // buffers to evaluate BRDF and PDF
+  const unsigned int num_pix = img_width * img_height;
+  for (unsigned int i_pix_start = 0; i_pix_start < num_pix; i_pix_start += num_pixel_batch) {
+    const unsigned int i_pix_end = std::min(i_pix_start + num_pixel_batch, num_pix);
+    timer.lap(0);
+    // ------------
+    // generate camera rays
+    queue_camera.clear();
+    for (unsigned int i_pix = i_pix_start; i_pix < i_pix_end; ++i_pix) {
+      const auto [cam_ray_src, cam_ray_dir] = get_ray_from_camera(
+          img_width, img_height, i_pix % img_width, i_pix / img_width);
+      queue_camera.push_back(i_pix, cam_ray_src, cam_ray_dir);
+    }
+    timer.lap(0);
+    // ------------
+    // intersect camera rays
+    intersect_ray_queue(queue_camera);
+    timer.num_ray += queue_camera.size();
+    timer.lap(1);
+    // ------------
+    // compact the hit paths and sort them by material
+    path2pix.clear();
+    path2pos.clear();
+    path2nrm.clear();
+    path2dir.clear();
+    path2object.clear();
+    for (auto &paths: object2paths) { paths.clear(); }
+    for (unsigned int i_ray = 0; i_ray < queue_camera.size(); ++i_ray) {
+      const int i_object = queue_camera.hit_object[i_ray];
+      if (i_object == -1) { continue; } // does not hit anything
+      const unsigned int i_pix = queue_camera.ray2path[i_ray];
+      img_mis[i_pix] += spheres[i_object].emission;
+      if (spheres[i_object].ratio_diffuse <= 0.f && spheres[i_object].ratio_specular <= 0.f) { continue; }
+      const Eigen::Vector3f dir = queue_camera.dir(i_ray);
+      const Eigen::Vector3f pos = Eigen::Vector3f(
+          queue_camera.org_x[i_ray], queue_camera.org_y[i_ray], queue_camera.org_z[i_ray])
+          + queue_camera.hit_depth[i_ray] * dir;
+      object2paths[i_object].push_back(path2pix.size());
+      path2pix.push_back(i_pix);
+      path2pos.push_back(pos);
+      path2nrm.push_back((pos - spheres[i_object].pos).normalized());
+      path2dir.push_back(dir);
+      path2object.push_back(i_object);
+    }
+    // decide the technique (light sampling or BRDF sampling) and the lobe of each sample
+    for (unsigned int i_object = 0; i_object < 4; ++i_object) {
+      const Sphere &sphere = spheres[i_object];
+      const float ratio_diffuse = sphere.ratio_diffuse / (sphere.ratio_diffuse + sphere.ratio_specular);
+      for (auto &paths: object2lobe2paths[i_object]) { paths.clear(); }
+      for (unsigned int i_path: object2paths[i_object]) {
+        for (unsigned int isample = 0; isample < num_half_sample; ++isample) {
+          object2lobe2paths[i_object][udist01(rndeng) < ratio_diffuse ? 0 : 1].push_back(i_path);
+          object2lobe2paths[i_object][2].push_back(i_path);
+        }
+      }
+    }
+    timer.lap(2);
+    // ------------
+    // shade: sample directions lobe by lobe, then evaluate the MIS weight of each ray material by material
+    queue_shadow.clear();
+    for (unsigned int i_object = 0; i_object < 4; ++i_object) {
+      const Sphere &sphere = spheres[i_object];
+      const size_t i_ray_start = queue_shadow.size();
+      for (unsigned int i_path: object2lobe2paths[i_object][0]) {
+        const Eigen::Vector2f unirand(udist01(rndeng), udist01(rndeng));
+        const auto dir = sampling_brdf_lambert(path2nrm[i_path], unirand).first;
+        queue_shadow.push_back(i_path, path2pos[i_path] + path2nrm[i_path] * 0.01, dir);
+      }
+      for (unsigned int i_path: object2lobe2paths[i_object][1]) {
+        const Eigen::Vector2f unirand(udist01(rndeng), udist01(rndeng));
+        const auto dir = sampling_brdf_specular(path2nrm[i_path], path2dir[i_path], sphere.lobe, unirand).first;
+        queue_shadow.push_back(i_path, path2pos[i_path] + path2nrm[i_path] * 0.01, dir);
+      }
+      for (unsigned int i_path: object2lobe2paths[i_object][2]) {
+        const auto dir = sampling_light(path2nrm[i_path], path2pos[i_path], path2dir[i_path], i_object, rndeng);
+        queue_shadow.push_back(i_path, path2pos[i_path] + path2nrm[i_path] * 0.01, dir);
+      }
+      const size_t num_ray = queue_shadow.size() - i_ray_start;
+      cos_theta.resize(num_ray);
+      cos_alpha.resize(num_ray);
+      lobe_value.resize(num_ray);
+      for (size_t i = 0; i < num_ray; ++i) {
+        const unsigned int i_path = queue_shadow.ray2path[i_ray_start + i];
+        const Eigen::Vector3f &nrm = path2nrm[i_path];
+        const Eigen::Vector3f &dir_in = path2dir[i_path];
+        const Eigen::Vector3f dir_out = queue_shadow.dir(i_ray_start + i);
+        const Eigen::Vector3f dir_mirror = dir_in - 2.f * dir_in.dot(nrm) * nrm;
+        cos_theta[i] = dir_out.dot(nrm);
+        cos_alpha[i] = dir_mirror.dot(dir_out);
+      }
+      sphere.lobe.values(num_ray, cos_alpha.data(), lobe_value.data()); // `cos_alpha` is overwritten
+      const float sum_ratio = sphere.ratio_diffuse + sphere.ratio_specular;
+      for (size_t i = 0; i < num_ray; ++i) {
+        if (cos_theta[i] <= 0.f) { continue; } // the weight stays zero
+        const unsigned int i_path = queue_shadow.ray2path[i_ray_start + i];
+        const float brdf = lobe_value[i] * sphere.ratio_specular + sphere.ratio_diffuse / float(M_PI);
+        const float pdf_brdf = (cos_theta[i] / float(M_PI) * sphere.ratio_diffuse
+            + lobe_value[i] * sphere.ratio_specular) / sum_ratio;
+        const float pdf_light = pdf_light_sample(
+            path2nrm[i_path], path2pos[i_path], path2dir[i_path], queue_shadow.dir(i_ray_start + i), i_object);
+        // balance heuristic with the same number of samples for the both techniques
+        queue_shadow.weight[i_ray_start + i] = brdf * cos_theta[i]
+            / (float(num_half_sample) * (pdf_brdf + pdf_light));
+      }
+    }
+    timer.lap(3);
+    // ------------
+    // shadow test: intersect the reflected rays and gather the emission
+    intersect_ray_queue(queue_shadow);
+    timer.num_ray += queue_shadow.size();
+    for (unsigned int i_ray = 0; i_ray < queue_shadow.size(); ++i_ray) {
+      const int i_object = queue_shadow.hit_object[i_ray];
+      if (i_object == -1) { continue; }
+      const unsigned int i_pix = path2pix[queue_shadow.ray2path[i_ray]];
+      img_mis[i_pix] += queue_shadow.weight[i_ray] * spheres[i_object].emission;
+    }
+    timer.lap(4);
+  }
+}
+
+/**
+ * render the features of the first hit that guide the denoiser
+ * @param[out] aux auxiliary buffers (normal, depth, albedo, object index)
+ */
+void render_auxiliary_buffers(acg::AuxiliaryBuffers &aux) {
+  for (unsigned int ih = 0; ih < aux.height; ++ih) {
+    for (unsigned int iw = 0; iw < aux.width; ++iw) {
+      const auto[cam_ray_src, cam_ray_dir] = get_ray_from_camera(aux.width, aux.height, iw, ih);
+      const auto[hit0_pos, hit0_normal, hit0_object] = hit_scene(cam_ray_src, cam_ray_dir);
+      if (hit0_object == -1) { continue; }
+      const Sphere &sphere = spheres[hit0_object];
+      // diffuse reflectance (the Lambertian term `ratio_diffuse / pi` integrates to `ratio_diffuse`)
+      const float albedo = sphere.emission > 0.f ? 1.f : sphere.ratio_diffuse;
+      aux.set(
+          ih * aux.width + iw,
+          hit0_normal.x(), hit0_normal.y(), hit0_normal.z(),
+          (hit0_pos - cam_ray_src).norm(), albedo, int(hit0_object));
+    }
+  }
+}
+
+/**
+ * write the auxiliary buffers as images `<prefix>_normal.png`, `<prefix>_depth.png`, ...
+ */
+void output_auxiliary_buffers(
+    const std::string &prefix,
+    const acg::AuxiliaryBuffers &aux) {
+  const unsigned int num_pix = aux.width * aux.height;
+  const float max_depth = *std::max_element(aux.pix2depth.begin(), aux.pix2depth.end());
+  std::vector<unsigned char> img_nrm(num_pix * 3, 0);
+  std::vector<unsigned char> img_depth(num_pix, 0), img_albedo(num_pix, 0), img_id(num_pix, 0);
+  for (unsigned int i_pix = 0; i_pix < num_pix; ++i_pix) {
+    for (int i_dim = 0; i_dim < 3; ++i_dim) {
+      img_nrm[i_pix * 3 + i_dim] = static_cast<unsigned char>((aux.pix2nrm[i_pix * 3 + i_dim] * 0.5f + 0.5f) * 255.f);
+    }
+    img_depth[i_pix] = max_depth > 0.f ? static_cast<unsigned char>(aux.pix2depth[i_pix] / max_depth * 255.f) : 0;
+    img_albedo[i_pix] = static_cast<unsigned char>(std::clamp(aux.pix2albedo[i_pix], 0.f, 1.f) * 255.f);
+    img_id[i_pix] = static_cast<unsigned char>((aux.pix2id[i_pix] + 1) * 50);
+  }
+  stbi_write_png((prefix + "_normal.png").c_str(), aux.width, aux.height, 3, img_nrm.data(), aux.width * 3);
+  stbi_write_png((prefix + "_depth.png").c_str(), aux.width, aux.height, 1, img_depth.data(), aux.width);
+  stbi_write_png((prefix + "_albedo.png").c_str(), aux.width, aux.height, 1, img_albedo.data(), aux.width);
+  stbi_write_png((prefix + "_id.png").c_str(), aux.width, aux.height, 1, img_id.data(), aux.width);
+}
+
+// --------------------------------------
+// progressive rendering with checkpoint
+
+/**
+ * Accumulation buffers of the progressive rendering.
+ * The buffers can be saved to a file and resumed later so that a killed job does not lose the samples.
+ */
+class ProgressiveImage {
+ public:
+  unsigned int width;
+  unsigned int height;
+  std::vector<float> pix2sum; // sum of the radiance over the samples
+  std::vector<unsigned int> pix2count; // number of samples accumulated at each pixel
+ public:
+  ProgressiveImage(unsigned int width_, unsigned int height_)
+      : width(width_), height(height_), pix2sum(width_ * height_, 0.f), pix2count(width_ * height_, 0) {}
+  /**
+   * add the estimate of one pass
+   * @param img_pass radiance estimated in the pass
+   * @param nsample number of samples used for the estimation
+   */
+  void add_pass(const std::vector<float> &img_pass, unsigned int nsample) {
+    for (unsigned int i_pix = 0; i_pix < width * height; ++i_pix) {
+      pix2sum[i_pix] += img_pass[i_pix] * float(nsample);
+      pix2count[i_pix] += nsample;
+    }
+  }
+  [[nodiscard]] unsigned int min_count() const {
+    return *std::min_element(pix2count.begin(), pix2count.end());
+  }
+  [[nodiscard]] std::vector<float> average() const {
+    std::vector<float> img(width * height, 0.f);
+    for (unsigned int i_pix = 0; i_pix < width * height; ++i_pix) {
+      if (pix2count[i_pix] == 0) { continue; }
+      img[i_pix] = pix2sum[i_pix] / float(pix2count[i_pix]);
+    }
+    return img;
+  }
+  /**
+   * Save the buffers. The data is first written to a temporary file and then renamed,
+   * so the previous checkpoint survives if the process is killed while writing.
+   * The buffers are not updated in place through a writable mapping on purpose: the pages of a mapping are
+   * flushed in no particular order, so a kill during the flush would leave the sums and the counts inconsistent.
+   * @param file_path path of the checkpoint file
+   * @return true if succeeded
+   */
+  [[nodiscard]] bool save(const std::filesystem::path &file_path) const {
+    const auto tmp_path = std::filesystem::path(file_path).concat(".tmp");
+    FILE *fp = fopen(tmp_path.string().c_str(), "wb");
+    if (!fp) { return false; }
+    const unsigned int header[3] = {checkpoint_magic, width, height};
+    bool is_ok = fwrite(header, sizeof(unsigned int), 3, fp) == 3;
+    is_ok = is_ok && fwrite(pix2sum.data(), sizeof(float), pix2sum.size(), fp) == pix2sum.size();
+    is_ok = is_ok && fwrite(pix2count.data(), sizeof(unsigned int), pix2count.size(), fp) == pix2count.size();
+    is_ok = (fclose(fp) == 0) && is_ok;
+    if (!is_ok) { return false; }
+    std::error_code ec;
+    std::filesystem::rename(tmp_path, file_path, ec);
+    return !ec;
+  }
+  /**
+   * Resume the buffers from the file mapped to the memory
+   * @param file_path path of the checkpoint file
+   * @return false if the file does not exist or its image size is different
+   */
+  bool load(const std::filesystem::path &file_path) {
+    const acg::MappedFile file(file_path);
+    const size_t num_pix = size_t(width) * height;
+    const size_t num_byte = sizeof(unsigned int) * 3 + (sizeof(float) + sizeof(unsigned int)) * num_pix;
+    if (!file.is_open() || file.size() != num_byte) { return false; }
+    unsigned int header[3];
+    std::memcpy(header, file.data(), sizeof(header));
+    if (header[0] != checkpoint_magic || header[1] != width || header[2] != height) { return false; }
+    const char *data_sum = file.data() + sizeof(header);
+    std::memcpy(pix2sum.data(), data_sum, sizeof(float) * num_pix);
+    std::memcpy(pix2count.data(), data_sum + sizeof(float) * num_pix, sizeof(unsigned int) * num_pix);
+    return true;
+  }
+ private:
+  static constexpr unsigned int checkpoint_magic = 0x41434731; // "ACG1"
+};
+
+/**
+ * Progressively render the MIS image adding passes over the whole image until
+ * the target number of samples or the time budget is reached, so a full-frame result is available at any time.
+ * If the checkpoint path is given, the accumulation buffers are checkpointed periodically and resumed from the file.
+ * @param[in,out] img accumulation buffers
+ * @param target_spp target number of samples per pixel (never exceeded; rounded down to an even number)
+ * @param time_budget wall-clock budget in seconds (no limit if it is not positive)
+ * @param checkpoint_path path of the checkpoint file (no checkpoint if it is empty)
+ * @param checkpoint_interval interval of the checkpoint in seconds
+ * @param rndeng random number generator
+ */
+void render_progressive_mis(
+    ProgressiveImage &img,
+    unsigned int target_spp,
+    double time_budget,
+    const std::filesystem::path &checkpoint_path,
+    double checkpoint_interval,
+    std::mt19937 &rndeng) {
+  constexpr unsigned int nsample_pass = 8; // number of samples per pixel in one pass
+  if (!checkpoint_path.empty() && img.load(checkpoint_path)) {
+    std::cout << "resumed from " << checkpoint_path << " with " << img.min_count() << " samples" << std::endl;
+  }
+  const auto time_start = std::chrono::steady_clock::now();
+  auto time_checkpoint = time_start;
+  auto seconds_since = [](std::chrono::steady_clock::time_point t) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - t).count();
+  };
+  WavefrontStatistics timer;
+  const unsigned int spp_start = img.min_count();
+  std::vector<float> img_pass(img.width * img.height);
+  while (img.min_count() < target_spp) {
+    if (time_budget > 0. && seconds_since(time_start) > time_budget) { break; }
+    // the last pass is smaller not to exceed the target, rounded down to an even number as MIS takes the samples
+    // in pairs, so an odd target stops one sample short
+    const unsigned int nsample = std::min(nsample_pass, target_spp - img.min_count()) / 2 * 2;
+    if (nsample == 0) { break; }
+    std::fill(img_pass.begin(), img_pass.end(), 0.f);
+    render_wavefront_mis(img.width, img.height, nsample, rndeng, img_pass, timer);
+    img.add_pass(img_pass, nsample);
+    if (!checkpoint_path.empty() && seconds_since(time_checkpoint) > checkpoint_interval) {
+      if (!img.save(checkpoint_path)) { std::cout << "failed to write checkpoint" << std::endl; }
+      time_checkpoint = std::chrono::steady_clock::now();
+    }
+  }
+  if (!checkpoint_path.empty() && !img.save(checkpoint_path)) { std::cout << "failed to write checkpoint" << std::endl; }
+  const double elapsed = seconds_since(time_start);
+  std::cout << "samples per pixel: " << img.min_count() << " (" << img.min_count() - spp_start << " in this run)" << std::endl;
+  std::cout << "computation time: " << elapsed << "s" << std::endl;
+  std::cout << "rays per second: " << double(timer.num_ray) / elapsed << std::endl;
+}
+
+int main(int argc, char *argv[]) {
   std::mt19937 rndeng(std::random_device{}());
   const unsigned int img_width = 300;
   const unsigned int img_height = 300;
@@ -344,6 +876,62 @@ int main() {
   std::vector<float> img_light(img_height * img_width, 0.0);
   std::vector<float> img_mis(img_height * img_width, 0.0);
   //
+  if (argc > 1 && std::string(argv[1]) == "wavefront") { // render only the MIS image in the wavefront manner
+    WavefrontStatistics timer;
+    render_wavefront_mis(img_width, img_height, 100, rndeng, img_mis, timer);
+    std::cout << "computation time of the wavefront stages" << std::endl;
+    timer.print();
+    output_float_image(
+        (std::filesystem::path(PROJECT_SOURCE_DIR) / "out_mis_wavefront.png").string().c_str(),
+        img_width, img_height, img_mis);
+    return 0;
+  }
+  if (argc > 1 && std::string(argv[1]) == "denoise") { // usage: task07 denoise [nsample]
+    const unsigned int nsample = argc > 2 ? std::stoi(argv[2]) : 16;
+    WavefrontStatistics timer;
+    render_wavefront_mis(img_width, img_height, nsample, rndeng, img_mis, timer);
+    acg::AuxiliaryBuffers aux(img_width, img_height);
+    render_auxiliary_buffers(aux);
+    const auto path_dir = std::filesystem::path(PROJECT_SOURCE_DIR);
+    output_float_image((path_dir / "out_mis_noisy.png").string().c_str(), img_width, img_height, img_mis);
+    output_auxiliary_buffers((path_dir / "out_aux").string(), aux);
+    acg::denoise_atrous(img_mis, 1, aux);
+    output_float_image((path_dir / "out_mis_denoised.png").string().c_str(), img_width, img_height, img_mis);
+    return 0;
+  }
+  if (argc > 1 && std::string(argv[1]) == "budget") { // usage: task07 budget <time_budget_sec> [sample_budget]
+    const double time_budget = argc > 2 ? std::stod(argv[2]) : 10.;
+    const unsigned long long sample_budget = argc > 3 ? std::stoull(argv[3]) : 0; // total over the image
+    if (time_budget <= 0. && sample_budget == 0) {
+      std::cout << "specify the time budget or the sample budget" << std::endl;
+      return 1;
+    }
+    if (sample_budget > 0 && sample_budget < 2 * img_width * img_height) { // MIS takes the samples in pairs
+      std::cout << "the sample budget is less than two samples per pixel (" << 2 * img_width * img_height << ")" << std::endl;
+      return 1;
+    }
+    const unsigned int target_spp = sample_budget > 0 ? // even number of samples per pixel within the budget
+        static_cast<unsigned int>(sample_budget / (img_width * img_height)) / 2 * 2 : std::numeric_limits<unsigned int>::max();
+    ProgressiveImage img(img_width, img_height);
+    render_progressive_mis(img, target_spp, time_budget, {}, 0., rndeng);
+    output_float_image(
+        (std::filesystem::path(PROJECT_SOURCE_DIR) / "out_mis_budget.png").string().c_str(),
+        img_width, img_height, img.average());
+    return 0;
+  }
+  if (argc > 1 && std::string(argv[1]) == "progressive") { // usage: task07 progressive [target_spp] [time_budget_sec]
+    const unsigned int target_spp = argc > 2 ? std::stoi(argv[2]) : 1000;
+    const double time_budget = argc > 3 ? std::stod(argv[3]) : 0.;
+    ProgressiveImage img(img_width, img_height);
+    render_progressive_mis(
+        img, target_spp, time_budget,
+        std::filesystem::path(PROJECT_SOURCE_DIR) / "out_mis_progressive.checkpoint", 30.,
+        rndeng);
+    output_float_image(
+        (std::filesystem::path(PROJECT_SOURCE_DIR) / "out_mis_progressive.png").string().c_str(),
+        img_width, img_height, img.average());
+    return 0;
+  }
   for (unsigned int iw = 0; iw < img_width; ++iw) {
     for (unsigned int ih = 0; ih < img_height; ++ih) {
       const auto[cam_ray_src, cam_ray_dir] = get_ray_from_camera(img_width, img_height, iw, ih);